@@ -22,13 +22,13 @@
 
 // VDR's own version number:
 
-#define VDRVERSION  "2.5.2"
-#define VDRVERSNUM   20502  // Version * 10000 + Major * 100 + Minor
+#define VDRVERSION  "2.5.3"
+#define VDRVERSNUM   20503  // Version * 10000 + Major * 100 + Minor
 
 // The plugin API's version number:
 
-#define APIVERSION  "2.5.2"
-#define APIVERSNUM   20502  // Version * 10000 + Major * 100 + Minor
+#define APIVERSION  "2.5.3"
+#define APIVERSNUM   20503  // Version * 10000 + Major * 100 + Minor
 
 // When loading plugins, VDR searches them by their APIVERSION, which
 // may be smaller than VDRVERSION in case there have been no changes to
@@ -366,6 +366,9 @@ public:
   int ChannelsWrap;
   int ShowChannelNamesWithSource;
   int EmergencyExit;
+  int TsBufferDelay;
+  int TsBufferLargeRead;
+  int VideoDirScanThreads;
   int __EndData__;
   cString InitialChannel;
   cString DeviceBondings;
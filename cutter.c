@@ -225,13 +225,17 @@ private:
   const char *error;
   bool isPesRecording;
   double framesPerSecond;
-  cUnbufferedFile *fromFile, *toFile;
+  cRecordingReader *reader;
+  cUnbufferedFile *toFile;
   cFileName *fromFileName, *toFileName;
   cIndexFile *fromIndex, *toIndex;
   cMarks fromMarks, toMarks;
   int numSequences;
   off_t maxVideoFileSize;
   off_t fileSize;
+  off_t bytesWritten;
+  cString toRecordingName;
+  time_t lastSizeUpdate;
   bool suspensionLogged;
   int sequence;          // cutting sequence
   int delta;             // time between two frames (PTS ticks)
@@ -245,14 +249,21 @@ private:
   int numIFrames;        // number of I-frames without pending packets
   cPatPmtParser patPmtParser;
   bool Throttled(void);
+  void UpdateRecordingSize(void);
   bool SwitchFile(bool Force = false);
-  bool LoadFrame(int Index, uchar *Buffer, bool &Independent, int &Length);
+  bool LoadFrame(int Index, uchar *Buffer, bool &Independent, int &Length, bool ReadAhead = false);
+       // Loads the frame at Index into Buffer. If ReadAhead is true, the following
+       // frames are read ahead in the background while this frame is processed.
   bool FramesAreEqual(int Index1, int Index2);
   void GetPendingPackets(uchar *Buffer, int &Length, int Index);
        // Gather all non-video TS packets from Index upward that either belong to
        // payloads that started before Index, or have a PTS that is before lastVidPts,
        // and add them to the end of the given Data.
   bool FixFrame(uchar *Data, int &Length, bool Independent, int Index, bool CutIn, bool CutOut);
+  int CopyFrames(int Index, int LastIndex);
+       // Copies the complete GOPs from the independent frame at Index up to (but not
+       // including) LastIndex (at most) as a whole, without looking at the actual data.
+       // Returns the number of frames copied, or -1 in case of an error.
   bool ProcessSequence(int LastEndIndex, int BeginIndex, int EndIndex, int NextBeginIndex);
 protected:
   virtual void Action(void);
@@ -260,13 +271,16 @@ public:
   cCuttingThread(const char *FromFileName, const char *ToFileName);
   virtual ~cCuttingThread();
   const char *Error(void) { return error; }
+  int NumFrames(void) { return toIndex ? toIndex->Last() + 1 : -1; }
+  int FileSizeMB(void) { return int(bytesWritten / MEGABYTE(1)); }
   };
 
 cCuttingThread::cCuttingThread(const char *FromFileName, const char *ToFileName)
 :cThread("video cutting", true)
 {
   error = NULL;
-  fromFile = toFile = NULL;
+  reader = NULL;
+  toFile = NULL;
   fromFileName = toFileName = NULL;
   fromIndex = toIndex = NULL;
   cRecording Recording(FromFileName);
@@ -274,6 +288,9 @@ cCuttingThread::cCuttingThread(const char *FromFileName, const char *ToFileName)
   framesPerSecond = Recording.FramesPerSecond();
   suspensionLogged = false;
   fileSize = 0;
+  bytesWritten = 0;
+  toRecordingName = ToFileName;
+  lastSizeUpdate = 0;
   sequence = 0;
   delta = int(round(PTSTICKS / framesPerSecond));
   lastVidPts = -1;
@@ -286,6 +303,7 @@ cCuttingThread::cCuttingThread(const char *FromFileName, const char *ToFileName)
   if (fromMarks.Load(FromFileName, framesPerSecond, isPesRecording) && fromMarks.Count()) {
      numSequences = fromMarks.GetNumSequences();
      if (numSequences > 0) {
+        reader = new cRecordingReader(FromFileName, isPesRecording, true);
         fromFileName = new cFileName(FromFileName, false, true, isPesRecording);
         toFileName = new cFileName(ToFileName, true, true, isPesRecording);
         fromIndex = new cIndexFile(FromFileName, false, isPesRecording);
@@ -306,12 +324,21 @@ cCuttingThread::cCuttingThread(const char *FromFileName, const char *ToFileName)
 cCuttingThread::~cCuttingThread()
 {
   Cancel(3);
+  delete reader;
   delete fromFileName;
   delete toFileName;
   delete fromIndex;
   delete toIndex;
 }
 
+void cCuttingThread::UpdateRecordingSize(void)
+{
+  if (toIndex) {
+     cRecordings::UpdateRecordingSize(toRecordingName, NumFrames(), FileSizeMB());
+     lastSizeUpdate = time(NULL);
+     }
+}
+
 bool cCuttingThread::Throttled(void)
 {
   if (cIoThrottle::Engaged()) {
@@ -328,23 +355,36 @@ bool cCuttingThread::Throttled(void)
   return false;
 }
 
-bool cCuttingThread::LoadFrame(int Index, uchar *Buffer, bool &Independent, int &Length)
+bool cCuttingThread::LoadFrame(int Index, uchar *Buffer, bool &Independent, int &Length, bool ReadAhead)
 {
   uint16_t FileNumber;
   off_t FileOffset;
   if (fromIndex->Get(Index, &FileNumber, &FileOffset, &Independent, &Length)) {
-     fromFile = fromFileName->SetOffset(FileNumber, FileOffset);
-     if (fromFile) {
-        fromFile->SetReadAhead(MEGABYTE(20));
-        int len = ReadFrame(fromFile, Buffer,  Length, MAXFRAMESIZE);
-        if (len < 0)
-           error = "ReadFrame";
-        else if (len != Length)
-           Length = len;
-        return error == NULL;
+     if (Length == -1)
+        Length = MAXFRAMESIZE; // this means we read up to EOF (see cIndex)
+     else if (Length > MAXFRAMESIZE) {
+        esyslog("ERROR: frame larger than buffer (%d > %d)", Length, MAXFRAMESIZE);
+        Length = MAXFRAMESIZE;
         }
-     else
-        error = "fromFile";
+     reader->Request(FileNumber, FileOffset, Length);
+     if (ReadAhead)
+        reader->ReadAhead(fromIndex, Index + 1);
+     uchar *b = NULL;
+     int len;
+     while ((len = reader->Result(&b)) < 0 && errno == EAGAIN)
+           reader->WaitForDataMs(100);
+     if (len > 0) {
+        memcpy(Buffer, b, len); // FixFrame() may append pending packets up to MAXFRAMESIZE
+        reader->Recycle(b, len);
+        Length = len;
+        }
+     else if (len == 0)
+        error = "fromFile"; // the file is missing or shorter than the index says
+     else {
+        LOG_ERROR;
+        error = "ReadFrame";
+        }
+     return error == NULL;
      }
   return false;
 }
@@ -352,11 +392,17 @@ bool cCuttingThread::LoadFrame(int Index, uchar *Buffer, bool &Independent, int
 bool cCuttingThread::SwitchFile(bool Force)
 {
   if (fileSize > maxVideoFileSize || Force) {
+     if (!toFileName->Close()) { // waits until all data has been written
+        toFile = NULL;
+        error = "toFile";
+        return false;
+        }
      toFile = toFileName->NextFile();
      if (!toFile) {
         error = "toFile";
         return false;
         }
+     toFile->SetAsyncWrite(true, true);
      fileSize = 0;
      }
   return true;
@@ -407,7 +453,7 @@ void cCuttingThread::GetPendingPackets(uchar *Data, int &Length, int Index)
   for (int NumIndependentFrames = 0; NumIndependentFrames < 2; Index++) {
       bool Independent;
       int len;
-      if (LoadFrame(Index, Buffer, Independent, len)) {
+      if (LoadFrame(Index, Buffer, Independent, len, true)) {
          if (Independent)
             NumIndependentFrames++;
          for (uchar *p = Buffer; len >= TS_SIZE && *p == TS_SYNC_BYTE; len -= TS_SIZE, p += TS_SIZE) {
@@ -541,6 +587,72 @@ bool cCuttingThread::FixFrame(uchar *Data, int &Length, bool Independent, int In
   return DeletedFrame;
 }
 
+#define MAXCOPYSIZE MEGABYTE(64) // the maximum number of bytes copied by one call to CopyFrames()
+
+int cCuttingThread::CopyFrames(int Index, int LastIndex)
+{
+  uint16_t FileNumber;
+  off_t FileOffset;
+  bool Independent;
+  if (!fromIndex->Get(Index, &FileNumber, &FileOffset, &Independent) || !Independent)
+     return 0;
+  // Every file shall start with an independent frame:
+  if (!SwitchFile())
+     return -1;
+  // Determine the frames that are contiguous in the same file:
+  int End = Index; // the frame following the last complete GOP
+  off_t Size = 0; // the number of bytes up to End
+  off_t s = 0;
+  for (int i = Index; i <= LastIndex; i++) {
+      uint16_t fn;
+      off_t fo;
+      bool ind;
+      int len;
+      if (!fromIndex->Get(i, &fn, &fo, &ind, &len))
+         break;
+      if (ind) {
+         End = i;
+         Size = s;
+         if (i == LastIndex || fileSize + s > maxVideoFileSize || s >= MAXCOPYSIZE)
+            break;
+         }
+      if (fn != FileNumber || fo != FileOffset + s || len <= 0)
+         break;
+      s += len;
+      }
+  if (End == Index)
+     return 0;
+  reader->Clear(); // whatever has been read ahead is copied here
+  // Write index:
+  for (int i = Index; i < End; i++) {
+      uint16_t fn;
+      off_t fo;
+      bool ind;
+      fromIndex->Get(i, &fn, &fo, &ind);
+      if (!toIndex->Write(ind, toFileName->Number(), fileSize + fo - FileOffset)) {
+         error = "toIndex";
+         return -1;
+         }
+      }
+  // Copy data:
+  AssertFreeDiskSpace(-1);
+  cUnbufferedFile *fromFile = fromFileName->SetOffset(FileNumber, FileOffset);
+  if (!fromFile) {
+     error = "fromFile";
+     return -1;
+     }
+  if (toFile->CopyFrom(fromFile, FileOffset, Size) != Size) {
+     LOG_ERROR;
+     error = "CopyFrom";
+     return -1;
+     }
+  fileSize += Size;
+  bytesWritten += Size;
+  if (time(NULL) - lastSizeUpdate >= RECORDINGSIZEUPDATE)
+     UpdateRecordingSize();
+  return End - Index;
+}
+
 bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIndex, int NextBeginIndex)
 {
   // Check for seamless connections:
@@ -552,10 +664,28 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
      error = "malloc";
      return false;
      }
+  // The frames near the end are processed individually, to determine the PTS of
+  // the last frame and the packets pending at the cut out:
+  int LastIndex = fromIndex->GetNextIFrame(EndIndex, false);
   for (int Index = BeginIndex; Running() && Index < EndIndex; Index++) {
+      // Copy complete GOPs in one go if they don't need to be fixed:
+      if (Index > BeginIndex && Index < LastIndex) {
+         // TS packets are left untouched by FixFrame() once any dangling packets
+         // have been stripped from the first sequence. Nothing that FixFrame()
+         // learns from them is needed later on, unless there is another sequence:
+         if (isPesRecording || sequence == 1 && numIFrames >= 2 && NextBeginIndex < 0) {
+            int n = CopyFrames(Index, LastIndex);
+            if (n < 0)
+               return false;
+            if (n > 0) {
+               Index += n - 1;
+               continue;
+               }
+            }
+         }
       bool Independent;
       int Length;
-      if (LoadFrame(Index, Buffer, Independent, Length)) {
+      if (LoadFrame(Index, Buffer, Independent, Length, true)) {
          // Make sure there is enough disk space:
          AssertFreeDiskSpace(-1);
          bool CutIn = !SeamlessBegin && Index == BeginIndex;
@@ -582,6 +712,9 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
             return false;
             }
          fileSize += Length;
+         bytesWritten += Length;
+         if (time(NULL) - lastSizeUpdate >= RECORDINGSIZEUPDATE)
+            UpdateRecordingSize();
          // Generate marks at the editing points in the edited recording:
          if (numSequences > 1 && Index == BeginIndex) {
             if (toMarks.Count() > 0)
@@ -599,10 +732,10 @@ bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIn
 void cCuttingThread::Action(void)
 {
   if (cMark *BeginMark = fromMarks.GetNextBegin()) {
-     fromFile = fromFileName->Open();
      toFile = toFileName->Open();
-     if (!fromFile || !toFile)
+     if (!toFile)
         return;
+     toFile->SetAsyncWrite(true, true);
      int LastEndIndex = -1;
      while (BeginMark && Running()) {
            // Suspend cutting if we have severe throughput problems:
@@ -637,6 +770,9 @@ void cCuttingThread::Action(void)
      }
   else
      esyslog("no editing marks found!");
+  if (!toFileName->Close() && !error) // waits until all data has been written
+     error = "toFile";
+  UpdateRecordingSize();
 }
 
 // --- cCutter ---------------------------------------------------------------
@@ -645,6 +781,8 @@ cCutter::cCutter(const char *FileName)
 {
   cuttingThread = NULL;
   error = false;
+  numFrames = -1;
+  fileSizeMB = -1;
   originalVersionName = FileName;
 }
 
@@ -691,6 +829,10 @@ void cCutter::Stop(void)
 {
   bool Interrupted = cuttingThread && cuttingThread->Active();
   const char *Error = cuttingThread ? cuttingThread->Error() : NULL;
+  if (cuttingThread) {
+     numFrames = cuttingThread->NumFrames();
+     fileSizeMB = cuttingThread->FileSizeMB();
+     }
   delete cuttingThread;
   cuttingThread = NULL;
   if ((Interrupted || Error) && *editedVersionName) {
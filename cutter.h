@@ -21,6 +21,8 @@ private:
   cString editedVersionName;
   cCuttingThread *cuttingThread;
   bool error;
+  int numFrames;
+  int fileSizeMB;
 public:
   cCutter(const char *FileName);
       ///< Sets up a new cutter for the given FileName, which must be the full path
@@ -42,6 +44,12 @@ public:
       ///< Returns true if the cutter is currently active.
   bool Error(void);
       ///< Returns true if an error occurred while cutting the recording.
+  int NumFrames(void) { return numFrames; }
+      ///< Returns the number of frames of the edited recording, once Active()
+      ///< has returned false (-1 before that).
+  int FileSizeMB(void) { return fileSizeMB; }
+      ///< Returns the total size of the edited recording's files (in MB), once
+      ///< Active() has returned false (-1 before that).
   };
 
 bool CutRecording(const char *FileName);
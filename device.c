@@ -9,6 +9,7 @@
 
 #include "device.h"
 #include <errno.h>
+#include <linux/dvb/dmx.h>
 #include <math.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -94,6 +95,7 @@ cDevice::cDevice(void)
   nitFilter = NULL;
 
   camSlot = NULL;
+  camSlotChanges = 0;
 
   occupiedTimeout = 0;
 
@@ -110,6 +112,8 @@ cDevice::cDevice(void)
 
   for (int i = 0; i < MAXRECEIVERS; i++)
       receiver[i] = NULL;
+  memset(pidReceivers, 0, sizeof(pidReceivers));
+  receiversChanged = false;
 
   if (numDevices < MAXDEVICES)
      device[numDevices++] = this;
@@ -446,6 +450,7 @@ void cDevice::SetCamSlot(cCamSlot *CamSlot)
 {
   LOCK_THREAD;
   camSlot = CamSlot;
+  camSlotChanges++;
 }
 
 void cDevice::Shutdown(void)
@@ -1677,68 +1682,106 @@ bool cDevice::Receiving(bool Dummy) const
 #define TS_SCRAMBLING_TIME_OK     3 // seconds before a Channel/CAM combination is marked as known to decrypt
 #define EIT_INJECTION_TIME       10 // seconds for which to inject EIT event
 
+#define MAXTSBATCH               64 // the maximum number of TS packets distributed to the receivers in one go
+
+void cDevice::CheckScrambling(cReceiver *Receiver, bool IsScrambled)
+{
+  // Check whether the TS packets are scrambled:
+  if (Receiver->startScrambleDetection) {
+     if (cCamSlot *cs = CamSlot()) {
+        int CamSlotNumber = cs->MasterSlotNumber();
+        if (Receiver->lastScrambledPacket < Receiver->startScrambleDetection)
+           Receiver->lastScrambledPacket = Receiver->startScrambleDetection;
+        time_t Now = time(NULL);
+        if (IsScrambled) {
+           Receiver->lastScrambledPacket = Now;
+           if (Now - Receiver->startScrambleDetection > Receiver->scramblingTimeout) {
+              if (!cs->IsActivating() || Receiver->Priority() >= LIVEPRIORITY) {
+                 if (Receiver->ChannelID().Valid()) {
+                    dsyslog("CAM %d: won't decrypt channel %s, detaching receiver", CamSlotNumber, *Receiver->ChannelID().ToString());
+                    ChannelCamRelations.SetChecked(Receiver->ChannelID(), CamSlotNumber);
+                    }
+                 Detach(Receiver);
+                 }
+              }
+           }
+        else if (Now - Receiver->lastScrambledPacket > TS_SCRAMBLING_TIME_OK) {
+           if (Receiver->ChannelID().Valid()) {
+              dsyslog("CAM %d: decrypts channel %s", CamSlotNumber, *Receiver->ChannelID().ToString());
+              ChannelCamRelations.SetDecrypt(Receiver->ChannelID(), CamSlotNumber);
+              }
+           Receiver->startScrambleDetection = 0;
+           }
+        }
+     }
+  // Inject EIT event to avoid the CAMs parental rating prompt:
+  if (Receiver->startEitInjection) {
+     time_t Now = time(NULL);
+     if (cCamSlot *cs = CamSlot()) {
+        if (Now != Receiver->lastEitInjection) { // once per second
+           cs->InjectEit(Receiver->ChannelID().Sid());
+           Receiver->lastEitInjection = Now;
+           }
+        }
+     if (Now - Receiver->startEitInjection > EIT_INJECTION_TIME)
+        Receiver->startEitInjection = 0;
+     }
+}
+
 void cDevice::Action(void)
 {
   if (Running() && OpenDvr()) {
      while (Running()) {
            // Read data from the DVR device:
            uchar *b = NULL;
-           if (GetTSPacket(b)) {
+           int Count = MAXTSBATCH;
+           int CamSlotChanges = camSlotChanges;
+           if (GetTSPackets(b, Count)) {
               if (b) {
-                 // Distribute the packet to all attached receivers:
+                 // Distribute the packets to all attached receivers:
+                 const uchar *Batch[MAXRECEIVERS][MAXTSBATCH];
+                 int BatchCount[MAXRECEIVERS] = { 0 };
+                 bool BatchScrambled[MAXRECEIVERS] = { false };
                  Lock();
                  cCamSlot *cs = CamSlot();
-                 if (cs)
-                    cs->TsPostProcess(b);
-                 int Pid = TsPid(b);
-                 bool IsScrambled = TsIsScrambled(b);
+                 // Data that has been fetched while the CAM slot was changed has not been
+                 // processed by that CAM, and may even be read-only (see cTSBuffer):
+                 bool PostProcess = cs && CamSlotChanges == camSlotChanges;
+                 mutexReceiver.Lock();
+                 for (; Count-- > 0; b += TS_SIZE) {
+                     if (PostProcess)
+                        cs->TsPostProcess(b);
+                     if (receiversChanged)
+                        BuildPidReceivers();
+                     int Pid = TsPid(b);
+                     bool IsScrambled = TsIsScrambled(b);
+                     uint32_t Receivers = pidReceivers[Pid];
+                     for (int i = 0; Receivers; i++, Receivers >>= 1) {
+                         if (!(Receivers & 1))
+                            continue;
+                         cReceiver *Receiver = receiver[i];
+                         if (!Receiver)
+                            continue; // was detached while processing this batch
+                         if (Receiver->batchReceive) {
+                            Batch[i][BatchCount[i]++] = b;
+                            BatchScrambled[i] |= IsScrambled;
+                            }
+                         else {
+                            Receiver->Receive(b, TS_SIZE);
+                            CheckScrambling(Receiver, IsScrambled);
+                            }
+                         }
+                     }
+                 // Deliver the collected packets to receivers that handle batches:
                  for (int i = 0; i < MAXRECEIVERS; i++) {
-                     cMutexLock MutexLock(&mutexReceiver);
-                     cReceiver *Receiver = receiver[i];
-                     if (Receiver && Receiver->WantsPid(Pid)) {
-                        Receiver->Receive(b, TS_SIZE);
-                        // Check whether the TS packet is scrambled:
-                        if (Receiver->startScrambleDetection) {
-                           if (cs) {
-                              int CamSlotNumber = cs->MasterSlotNumber();
-                              if (Receiver->lastScrambledPacket < Receiver->startScrambleDetection)
-                                 Receiver->lastScrambledPacket = Receiver->startScrambleDetection;
-                              time_t Now = time(NULL);
-                              if (IsScrambled) {
-                                 Receiver->lastScrambledPacket = Now;
-                                 if (Now - Receiver->startScrambleDetection > Receiver->scramblingTimeout) {
-                                    if (!cs->IsActivating() || Receiver->Priority() >= LIVEPRIORITY) {
-                                       if (Receiver->ChannelID().Valid()) {
-                                          dsyslog("CAM %d: won't decrypt channel %s, detaching receiver", CamSlotNumber, *Receiver->ChannelID().ToString());
-                                          ChannelCamRelations.SetChecked(Receiver->ChannelID(), CamSlotNumber);
-                                          }
-                                       Detach(Receiver);
-                                       }
-                                    }
-                                 }
-                              else if (Now - Receiver->lastScrambledPacket > TS_SCRAMBLING_TIME_OK) {
-                                 if (Receiver->ChannelID().Valid()) {
-                                    dsyslog("CAM %d: decrypts channel %s", CamSlotNumber, *Receiver->ChannelID().ToString());
-                                    ChannelCamRelations.SetDecrypt(Receiver->ChannelID(), CamSlotNumber);
-                                    }
-                                 Receiver->startScrambleDetection = 0;
-                                 }
-                              }
-                           }
-                        // Inject EIT event to avoid the CAMs parental rating prompt:
-                        if (Receiver->startEitInjection) {
-                           time_t Now = time(NULL);
-                           if (cCamSlot *cs = CamSlot()) {
-                              if (Now != Receiver->lastEitInjection) { // once per second
-                                 cs->InjectEit(Receiver->ChannelID().Sid());
-                                 Receiver->lastEitInjection = Now;
-                                 }
-                              }
-                           if (Now - Receiver->startEitInjection > EIT_INJECTION_TIME)
-                              Receiver->startEitInjection = 0;
+                     if (BatchCount[i]) {
+                        if (cReceiver *Receiver = receiver[i]) {
+                           Receiver->ReceiveBatch(Batch[i], BatchCount[i]);
+                           CheckScrambling(Receiver, BatchScrambled[i]);
                            }
                         }
                      }
+                 mutexReceiver.Unlock();
                  Unlock();
                  }
               }
@@ -1763,6 +1806,33 @@ bool cDevice::GetTSPacket(uchar *&Data)
   return false;
 }
 
+bool cDevice::GetTSPackets(uchar *&Data, int &Count)
+{
+  if (GetTSPacket(Data)) {
+     Count = Data ? 1 : 0;
+     return true;
+     }
+  return false;
+}
+
+void cDevice::ReceiversChanged(void)
+{
+  cMutexLock MutexLock(&mutexReceiver);
+  receiversChanged = true;
+}
+
+void cDevice::BuildPidReceivers(void)
+{
+  memset(pidReceivers, 0, sizeof(pidReceivers));
+  for (int i = 0; i < MAXRECEIVERS; i++) {
+      if (cReceiver *Receiver = receiver[i]) {
+         for (int n = 0; n < Receiver->numPids; n++)
+             pidReceivers[Receiver->pids[n] & (MAXPID - 1)] |= 1 << i;
+         }
+      }
+  receiversChanged = false;
+}
+
 bool cDevice::AttachReceiver(cReceiver *Receiver)
 {
   if (!Receiver)
@@ -1791,6 +1861,7 @@ bool cDevice::AttachReceiver(cReceiver *Receiver)
          Receiver->Activate(true);
          Receiver->device = this;
          receiver[i] = Receiver;
+         receiversChanged = true;
          if (camSlot && Receiver->priority > MINPRIORITY) { // priority check to avoid an infinite loop with the CAM slot's caPidReceiver
             camSlot->StartDecrypting();
             if (camSlot->WantsTsData()) {
@@ -1827,6 +1898,7 @@ void cDevice::Detach(cReceiver *Receiver)
       else if (receiver[i])
          receiversLeft = true;
       }
+  receiversChanged = true;
   mutexReceiver.Unlock();
   Receiver->device = NULL;
   Receiver->Activate(false);
@@ -1864,12 +1936,29 @@ void cDevice::DetachAllReceivers(void)
 
 // --- cTSBuffer -------------------------------------------------------------
 
-cTSBuffer::cTSBuffer(int File, int Size, int DeviceNumber)
+#define TSBUFFERMMAPMAXSIZE  (4096 * TS_SIZE) // the maximum size of a memory mapped driver buffer (as limited by the driver)
+#define TSBUFFERTHROTTLEHIGH 50 // percentage of memory mapped driver buffers waiting to be delivered that activates the i/o throttle
+#define TSBUFFERTHROTTLELOW  20 // percentage below which the i/o throttle is released again
+
+cTSBuffer::cTSBuffer(int File, int Size, int DeviceNumber, bool MemoryMapped)
 {
   SetDescription("device %d TS buffer", DeviceNumber);
   f = File;
   deviceNumber = DeviceNumber;
   delivered = 0;
+  ringBuffer = NULL;
+  numMmapBuffers = 0;
+  mmapBufferSize = 0;
+  mmapIndex = -1;
+  mmapData = NULL;
+  mmapUsed = mmapOffset = 0;
+  mmapFilledHead = numMmapFilled = 0;
+  bounceBuffer = NULL;
+  writable = false;
+  numReads = numWakeups = 0;
+  bytesRead = 0;
+  if (MemoryMapped && SetupMmap(Size))
+     return;
   ringBuffer = new cRingBufferLinear(Size, TS_SIZE, true, "TS");
   ringBuffer->SetTimeouts(100, 100);
   ringBuffer->SetIoThrottle();
@@ -1879,7 +1968,191 @@ cTSBuffer::cTSBuffer(int File, int Size, int DeviceNumber)
 cTSBuffer::~cTSBuffer()
 {
   Cancel(3);
+  dsyslog("device %d TS buffer stats: %d reads, %d bytes average, %.1f wakeups/s", deviceNumber, numReads, AverageReadSize(), WakeupsPerSecond());
   delete ringBuffer;
+  CloseMmap();
+  free(bounceBuffer);
+}
+
+bool cTSBuffer::SetupMmap(int Size)
+{
+#ifdef DMX_REQBUFS
+  dmx_requestbuffers rb;
+  rb.count = TSBUFFERMMAPCOUNT;
+  rb.size = min(Size / TSBUFFERMMAPCOUNT, TSBUFFERMMAPMAXSIZE) / TS_SIZE * TS_SIZE;
+  if (ioctl(f, DMX_REQBUFS, &rb) < 0 || rb.count == 0) {
+     dsyslog("device %d: memory mapped DVR buffers not supported - using read()", deviceNumber);
+     return false;
+     }
+  int Count = min(int(rb.count), TSBUFFERMMAPCOUNT);
+  for (int i = 0; i < Count; i++) {
+      dmx_buffer b;
+      memset(&b, 0, sizeof(b));
+      b.index = i;
+      if (ioctl(f, DMX_QUERYBUF, &b) < 0) {
+         LOG_ERROR;
+         break;
+         }
+      void *p = mmap(NULL, b.length, PROT_READ, MAP_SHARED, f, b.offset);
+      if (p == MAP_FAILED) {
+         LOG_ERROR;
+         break;
+         }
+      mmapBuffers[numMmapBuffers++] = (uchar *)p;
+      mmapBufferSize = b.length;
+      if (ioctl(f, DMX_QBUF, &b) < 0) {
+         LOG_ERROR;
+         break;
+         }
+      }
+  if (numMmapBuffers == Count && mmapBufferSize > 0) {
+     dsyslog("device %d: using %d memory mapped DVR buffers of %d bytes", deviceNumber, numMmapBuffers, mmapBufferSize);
+     return true;
+     }
+  esyslog("ERROR: can't set up memory mapped DVR buffers on device %d - using read()", deviceNumber);
+  CloseMmap();
+#endif
+  return false;
+}
+
+void cTSBuffer::CloseMmap(void)
+{
+#ifdef DMX_REQBUFS
+  if (numMmapBuffers) {
+     for (int i = 0; i < numMmapBuffers; i++)
+         munmap(mmapBuffers[i], mmapBufferSize);
+     numMmapBuffers = 0;
+     mmapIndex = -1;
+     mmapData = NULL;
+     mmapFilledHead = numMmapFilled = 0;
+     mmapIoThrottle.Release();
+     dmx_requestbuffers rb;
+     rb.count = rb.size = 0;
+     ioctl(f, DMX_REQBUFS, &rb); // releases the driver's buffers
+     }
+#endif
+}
+
+bool cTSBuffer::FetchMmap(void)
+{
+  // Dequeues all the buffers the driver has filled so far, so that we know how far
+  // the consumer of the data is lagging behind:
+  bool Fetched = false;
+#ifdef DMX_REQBUFS
+  cPoller Poller(f);
+  while (numMmapFilled < numMmapBuffers && Poller.Poll(0)) {
+        dmx_buffer b;
+        memset(&b, 0, sizeof(b));
+        if (ioctl(f, DMX_DQBUF, &b) < 0) {
+           if (FATALERRNO)
+              LOG_ERROR;
+           break;
+           }
+        if (int(b.index) >= numMmapBuffers) {
+           esyslog("ERROR: invalid DVR buffer index %d on device %d", b.index, deviceNumber);
+           break;
+           }
+        int i = (mmapFilledHead + numMmapFilled++) % TSBUFFERMMAPCOUNT;
+        mmapFilled[i] = b.index;
+        mmapFilledUsed[i] = min(int(b.bytesused), mmapBufferSize);
+        Fetched = true;
+        }
+#endif
+  return Fetched;
+}
+
+bool cTSBuffer::DequeueMmap(int TimeoutMs)
+{
+#ifdef DMX_REQBUFS
+  if (FetchMmap())
+     numWakeups++;
+  else if (!numMmapFilled) {
+     cPoller Poller(f);
+     if (Poller.Poll(TimeoutMs) && FetchMmap())
+        numWakeups++;
+     }
+  // Like cRingBuffer, throttle other i/o (cutting, deleting etc.) while the
+  // data isn't consumed as fast as it comes in:
+  int Percent = numMmapFilled * 100 / numMmapBuffers;
+  if (Percent >= TSBUFFERTHROTTLEHIGH)
+     mmapIoThrottle.Activate();
+  else if (Percent < TSBUFFERTHROTTLELOW)
+     mmapIoThrottle.Release();
+  if (numMmapFilled) {
+     mmapIndex = mmapFilled[mmapFilledHead];
+     mmapData = mmapBuffers[mmapIndex];
+     mmapUsed = mmapFilledUsed[mmapFilledHead];
+     mmapOffset = 0;
+     mmapFilledHead = (mmapFilledHead + 1) % TSBUFFERMMAPCOUNT;
+     numMmapFilled--;
+     numReads++;
+     bytesRead += mmapUsed;
+     return true;
+     }
+#endif
+  return false;
+}
+
+void cTSBuffer::ReleaseMmap(void)
+{
+#ifdef DMX_REQBUFS
+  if (mmapIndex >= 0) {
+     dmx_buffer b;
+     memset(&b, 0, sizeof(b));
+     b.index = mmapIndex;
+     if (ioctl(f, DMX_QBUF, &b) < 0)
+        LOG_ERROR;
+     }
+#endif
+  mmapIndex = -1;
+  mmapData = NULL;
+  mmapUsed = mmapOffset = 0;
+}
+
+uchar *cTSBuffer::GetMmap(int *Available, bool CheckAvailable)
+{
+  mmapOffset += delivered;
+  delivered = 0;
+  if (mmapData && mmapUsed - mmapOffset < TS_SIZE) {
+     if (mmapUsed > mmapOffset)
+        esyslog("ERROR: skipped %d bytes of incomplete TS packet on device %d", mmapUsed - mmapOffset, deviceNumber);
+     ReleaseMmap(); // hands the buffer back to the driver
+     }
+  if (!mmapData && !DequeueMmap(CheckAvailable ? 0 : 100))
+     return NULL;
+  if (writable && mmapIndex >= 0) {
+     // The driver's buffers are read-only, so we need to copy the data:
+     if (!bounceBuffer)
+        bounceBuffer = MALLOC(uchar, mmapBufferSize);
+     if (!bounceBuffer) {
+        esyslog("ERROR: can't allocate TS bounce buffer on device %d", deviceNumber);
+        return NULL;
+        }
+     int Count = mmapUsed - mmapOffset;
+     memcpy(bounceBuffer, mmapData + mmapOffset, Count);
+     ReleaseMmap();
+     mmapData = bounceBuffer;
+     mmapUsed = Count;
+     }
+  int Count = mmapUsed - mmapOffset;
+  if (Count < TS_SIZE)
+     return NULL;
+  uchar *p = mmapData + mmapOffset;
+  if (*p != TS_SYNC_BYTE) {
+     for (int i = 1; i < Count; i++) {
+         if (p[i] == TS_SYNC_BYTE) {
+            Count = i;
+            break;
+            }
+         }
+     mmapOffset += Count;
+     esyslog("ERROR: skipped %d bytes to sync on TS packet on device %d", Count, deviceNumber);
+     return NULL;
+     }
+  delivered = TS_SIZE;
+  if (Available)
+     *Available = Count;
+  return p;
 }
 
 void cTSBuffer::Action(void)
@@ -1890,8 +2163,13 @@ void cTSBuffer::Action(void)
      while (Running()) {
            if (firstRead || Poller.Poll(100)) {
               firstRead = false;
+              numWakeups++;
               int r = ringBuffer->Read(f);
-              if (r < 0 && FATALERRNO) {
+              if (r > 0) {
+                 numReads++;
+                 bytesRead += r;
+                 }
+              else if (r < 0 && FATALERRNO) {
                  if (errno == EOVERFLOW)
                     esyslog("ERROR: driver buffer overflow on device %d", deviceNumber);
                  else {
@@ -1899,14 +2177,26 @@ void cTSBuffer::Action(void)
                     break;
                     }
                  }
-              cCondWait::SleepMs(10); // avoids small chunks of data, which cause high CPU usage, esp. on ARM CPUs
+              // Sleep a little to avoid small chunks of data, which cause high CPU usage, esp. on
+              // ARM CPUs, unless the data is coming in fast and there is enough room to take it:
+              int LargeRead = KILOBYTE(Setup.TsBufferLargeRead);
+              if (Setup.TsBufferDelay > 0 && (r < LargeRead || ringBuffer->Free() < 2 * max(LargeRead, TS_SIZE)))
+                 cCondWait::SleepMs(Setup.TsBufferDelay);
               }
            }
      }
 }
 
+double cTSBuffer::WakeupsPerSecond(void) const
+{
+  uint64_t Elapsed = statsTimer.Elapsed();
+  return Elapsed ? numWakeups * 1000.0 / Elapsed : 0;
+}
+
 uchar *cTSBuffer::Get(int *Available, bool CheckAvailable)
 {
+  if (numMmapBuffers)
+     return GetMmap(Available, CheckAvailable);
   int Count = 0;
   if (delivered) {
      ringBuffer->Del(delivered);
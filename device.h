@@ -465,6 +465,7 @@ public:
 
 private:
   cCamSlot *camSlot;
+  int camSlotChanges; // incremented whenever camSlot is changed
 public:
   virtual bool HasCi(void);
          ///< Returns true if this device has a Common Interface.
@@ -830,6 +831,17 @@ public:
 private:
   mutable cMutex mutexReceiver;
   cReceiver *receiver[MAXRECEIVERS];
+  uint32_t pidReceivers[MAXPID]; // bit i is set if receiver[i] wants the PID
+  bool receiversChanged;
+  void ReceiversChanged(void);
+       ///< Marks the PID-to-receiver dispatch table as outdated.
+  void BuildPidReceivers(void);
+       ///< Rebuilds the PID-to-receiver dispatch table. Must be called with
+       ///< mutexReceiver locked.
+  void CheckScrambling(cReceiver *Receiver, bool IsScrambled);
+       ///< Checks whether the CAM is able to decrypt the TS packets just delivered
+       ///< to the given Receiver (detaching it if it isn't) and injects EIT events
+       ///< if necessary. IsScrambled tells whether any of these packets was scrambled.
 public:
   int Priority(void) const;
       ///< Returns the priority of the current receiving session (-MAXPRIORITY..MAXPRIORITY),
@@ -847,6 +859,14 @@ protected:
       ///< new data available, Data will be set to NULL. The function returns
       ///< false in case of a non recoverable error, otherwise it returns true,
       ///< even if Data is NULL.
+  virtual bool GetTSPackets(uchar *&Data, int &Count);
+      ///< Gets a run of up to Count consecutive TS packets from the DVR of this
+      ///< device and returns a pointer to the first one in Data. Upon return,
+      ///< Count contains the actual number of packets, which all start with
+      ///< TS_SYNC_BYTE and are TS_SIZE bytes apart. If there is currently no new
+      ///< data available, Data will be set to NULL. The return value has the
+      ///< same meaning as in GetTSPacket(). The default implementation simply
+      ///< calls GetTSPacket() and delivers a single packet.
 public:
   bool Receiving(bool Dummy = false) const;
        ///< Returns true if we are currently receiving. The parameter has no meaning (for backwards compatibility only).
@@ -867,6 +887,10 @@ public:
 /// of getting each TS packet separately from the driver. It also makes
 /// sure the returned data points to a TS packet and automatically
 /// re-synchronizes after broken packets.
+/// If the driver supports it, cTSBuffer can also hand out the data directly
+/// from memory mapped driver buffers, without copying it.
+
+#define TSBUFFERMMAPCOUNT 32 // the maximum number of memory mapped driver buffers
 
 class cTSBuffer : public cThread {
 private:
@@ -874,10 +898,53 @@ private:
   int deviceNumber;
   int delivered;
   cRingBufferLinear *ringBuffer;
+  int numMmapBuffers;
+  uchar *mmapBuffers[TSBUFFERMMAPCOUNT];
+  int mmapBufferSize;
+  int mmapIndex; // the driver buffer mmapData points into (-1 = none)
+  uchar *mmapData;
+  int mmapUsed;
+  int mmapOffset;
+  int mmapFilled[TSBUFFERMMAPCOUNT]; // driver buffers that have been dequeued, but not yet delivered
+  int mmapFilledUsed[TSBUFFERMMAPCOUNT]; // the number of bytes in each of them
+  int mmapFilledHead;
+  int numMmapFilled;
+  cIoThrottle mmapIoThrottle;
+  uchar *bounceBuffer;
+  bool writable;
+  int numReads;
+  int numWakeups;
+  int64_t bytesRead;
+  cTimeMs statsTimer;
+  bool SetupMmap(int Size);
+  void CloseMmap(void);
+  bool FetchMmap(void);
+  bool DequeueMmap(int TimeoutMs);
+  void ReleaseMmap(void);
+  uchar *GetMmap(int *Available, bool CheckAvailable);
   virtual void Action(void);
 public:
-  cTSBuffer(int File, int Size, int DeviceNumber);
+  cTSBuffer(int File, int Size, int DeviceNumber, bool MemoryMapped = false);
+     ///< Creates a TS buffer that reads from the given File. If MemoryMapped
+     ///< is true, and the driver supports the memory mapped streaming I/O of
+     ///< the Linux DVB API, the data will be delivered directly from the driver's
+     ///< buffers. Otherwise a thread reads the data into a ring buffer of the
+     ///< given Size.
   virtual ~cTSBuffer();
+  bool MemoryMapped(void) const { return numMmapBuffers > 0; }
+     ///< Returns true if this buffer delivers its data from memory mapped
+     ///< driver buffers.
+  int AverageReadSize(void) const { return numReads ? int(bytesRead / numReads) : 0; }
+     ///< Returns the average number of bytes read from the driver with each
+     ///< read() (or dequeued memory mapped buffer).
+  double WakeupsPerSecond(void) const;
+     ///< Returns the average number of times per second this buffer has
+     ///< woken up to read data from the driver.
+  void SetWritable(bool On) { writable = On; }
+     ///< Memory mapped driver buffers are read-only. If the caller needs to modify
+     ///< the data returned by Get() (like for decrypting it), it must call
+     ///< SetWritable(true) before calling Get(), which will then copy the data
+     ///< into a separate buffer.
   uchar *Get(int *Available = NULL, bool CheckAvailable = false);
      ///< Returns a pointer to the first TS packet in the buffer. If Available is given,
      ///< it will return the total number of consecutive bytes pointed to in the buffer.
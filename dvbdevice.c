@@ -2322,7 +2322,7 @@ bool cDvbDevice::OpenDvr(void)
   CloseDvr();
   fd_dvr = DvbOpen(DEV_DVB_DVR, adapter, frontend, O_RDONLY | O_NONBLOCK, true);
   if (fd_dvr >= 0)
-     tsBuffer = new cTSBuffer(fd_dvr, TSBUFFERSIZE, DeviceNumber() + 1);
+     tsBuffer = new cTSBuffer(fd_dvr, TSBUFFERSIZE, DeviceNumber() + 1, true);
   return fd_dvr >= 0;
 }
 
@@ -2339,17 +2339,17 @@ void cDvbDevice::CloseDvr(void)
 bool cDvbDevice::GetTSPacket(uchar *&Data)
 {
   if (tsBuffer) {
-     if (cCamSlot *cs = CamSlot()) {
-        if (cs->WantsTsData()) {
-           int Available;
-           Data = tsBuffer->Get(&Available, checkTsBuffer);
-           if (!Data)
-              Available = 0;
-           Data = cs->Decrypt(Data, Available);
-           tsBuffer->Skip(Available);
-           checkTsBuffer = Data != NULL;
-           return true;
-           }
+     cCamSlot *cs = CamSlot();
+     tsBuffer->SetWritable(cs != NULL); // the data may be modified by the CAM
+     if (cs && cs->WantsTsData()) {
+        int Available;
+        Data = tsBuffer->Get(&Available, checkTsBuffer);
+        if (!Data)
+           Available = 0;
+        Data = cs->Decrypt(Data, Available);
+        tsBuffer->Skip(Available);
+        checkTsBuffer = Data != NULL;
+        return true;
         }
      Data = tsBuffer->Get();
      return true;
@@ -2357,6 +2357,33 @@ bool cDvbDevice::GetTSPacket(uchar *&Data)
   return false;
 }
 
+bool cDvbDevice::GetTSPackets(uchar *&Data, int &Count)
+{
+  if (tsBuffer) {
+     cCamSlot *cs = CamSlot();
+     if (cs && cs->WantsTsData()) {
+        // the CAM decrypts one packet at a time:
+        bool Result = GetTSPacket(Data);
+        Count = Data ? 1 : 0;
+        return Result;
+        }
+     tsBuffer->SetWritable(cs != NULL); // the data may be modified by the CAM
+     int Available;
+     Data = tsBuffer->Get(&Available);
+     if (Data) {
+        int n = 1;
+        for (int Max = min(Count, Available / TS_SIZE); n < Max && Data[n * TS_SIZE] == TS_SYNC_BYTE; n++)
+            ;
+        tsBuffer->Skip(n * TS_SIZE);
+        Count = n;
+        }
+     else
+        Count = 0;
+     return true;
+     }
+  return false;
+}
+
 void cDvbDevice::DetachAllReceivers(void)
 {
   cMutexLock MutexLock(&bondMutex);
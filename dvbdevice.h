@@ -285,6 +285,7 @@ protected:
   virtual bool OpenDvr(void);
   virtual void CloseDvr(void);
   virtual bool GetTSPacket(uchar *&Data);
+  virtual bool GetTSPackets(uchar *&Data, int &Count);
   virtual void DetachAllReceivers(void);
   };
 
@@ -120,127 +120,21 @@ int cPtsIndex::FindFrameNumber(uint32_t Pts)
   return Valid ? FrameNumber : FindIndex(Pts); // fall back during trick speeds
 }
 
-// --- cNonBlockingFileReader ------------------------------------------------
-
-class cNonBlockingFileReader : public cThread {
-private:
-  cUnbufferedFile *f;
-  uchar *buffer;
-  int wanted;
-  int length;
-  cCondWait newSet;
-  cCondVar newDataCond;
-  cMutex newDataMutex;
-protected:
-  void Action(void);
-public:
-  cNonBlockingFileReader(void);
-  ~cNonBlockingFileReader();
-  void Clear(void);
-  void Request(cUnbufferedFile *File, int Length);
-  int Result(uchar **Buffer);
-  bool Reading(void) { return buffer; }
-  bool WaitForDataMs(int msToWait);
-  };
-
-cNonBlockingFileReader::cNonBlockingFileReader(void)
-:cThread("non blocking file reader")
-{
-  f = NULL;
-  buffer = NULL;
-  wanted = length = 0;
-  Start();
-}
-
-cNonBlockingFileReader::~cNonBlockingFileReader()
-{
-  newSet.Signal();
-  Cancel(3);
-  free(buffer);
-}
-
-void cNonBlockingFileReader::Clear(void)
-{
-  Lock();
-  f = NULL;
-  free(buffer);
-  buffer = NULL;
-  wanted = length = 0;
-  Unlock();
-}
-
-void cNonBlockingFileReader::Request(cUnbufferedFile *File, int Length)
-{
-  Lock();
-  Clear();
-  wanted = Length;
-  buffer = MALLOC(uchar, wanted);
-  f = File;
-  Unlock();
-  newSet.Signal();
-}
-
-int cNonBlockingFileReader::Result(uchar **Buffer)
-{
-  LOCK_THREAD;
-  if (buffer && length == wanted) {
-     *Buffer = buffer;
-     buffer = NULL;
-     return wanted;
-     }
-  errno = EAGAIN;
-  return -1;
-}
-
-void cNonBlockingFileReader::Action(void)
-{
-  while (Running()) {
-        Lock();
-        if (f && buffer && length < wanted) {
-           int r = f->Read(buffer + length, wanted - length);
-           if (r > 0)
-              length += r;
-           else if (r == 0) { // r == 0 means EOF
-              if (length > 0)
-                 wanted = length; // already read something, so return the rest
-              else
-                 length = wanted = 0; // report EOF
-              }
-           else if (FATALERRNO) {
-              LOG_ERROR;
-              length = wanted = r; // this will forward the error status to the caller
-              }
-           if (length == wanted) {
-              cMutexLock NewDataLock(&newDataMutex);
-              newDataCond.Broadcast();
-              }
-           }
-        Unlock();
-        newSet.Wait(1000);
-        }
-}
-
-bool cNonBlockingFileReader::WaitForDataMs(int msToWait)
-{
-  cMutexLock NewDataLock(&newDataMutex);
-  if (buffer && length == wanted)
-     return true;
-  return newDataCond.TimedWait(newDataMutex, msToWait);
-}
-
 // --- cDvbPlayer ------------------------------------------------------------
 
 #define PLAYERBUFSIZE  (MAXFRAMESIZE * 5)
 
 #define RESUMEBACKUP 10 // number of seconds to back up when resuming an interrupted replay session
 #define MAXSTUCKATEOF 3 // max. number of seconds to wait in case the device doesn't play the last frame
+#define TRICKREADAHEAD 6 // number of I-frames to read ahead in fast forward/rewind mode
+#define TRICKSTATSINTERVAL 1000 // ms over which the number of I-frames delivered in trick mode is measured
 
 class cDvbPlayer : public cPlayer, cThread {
 private:
   enum ePlayModes { pmPlay, pmPause, pmSlow, pmFast, pmStill };
   enum ePlayDirs { pdForward, pdBackward };
   static int Speeds[];
-  cNonBlockingFileReader *nonBlockingFileReader;
+  cRecordingReader *reader;
   cRingBufferFrame *ringBuffer;
   cPtsIndex ptsIndex;
   const cMarks *marks;
@@ -261,7 +155,12 @@ private:
   cFrame *playFrame;
   cFrame *dropFrame;
   bool resyncAfterPause;
+  int trickFrames;
+  cTimeMs trickTimer;
+  double iFramesPerSecond;
   void TrickSpeed(int Increment);
+  int GetNextTrickFrame(int Index, uint16_t *FileNumber, off_t *FileOffset, int *Length);
+  void TrickReadAhead(int Index);
   void Empty(void);
   bool NextFile(uint16_t FileNumber = 0, off_t FileOffset = -1);
   int Resume(void);
@@ -286,6 +185,7 @@ public:
   virtual bool GetIndex(int &Current, int &Total, bool SnapToIFrame = false);
   virtual bool GetFrameNumber(int &Current, int &Total);
   virtual bool GetReplayMode(bool &Play, bool &Forward, int &Speed);
+  double IFramesPerSecond(void) { return iFramesPerSecond; }
   };
 
 #define MAX_VIDEO_SLOWMOTION 63 // max. arg to pass to VIDEO_SLOWMOTION // TODO is this value correct?
@@ -297,7 +197,7 @@ int cDvbPlayer::Speeds[] = { 0, -2, -4, -8, 1, 2, 4, 12, 0 };
 cDvbPlayer::cDvbPlayer(const char *FileName, bool PauseLive)
 :cThread("dvbplayer")
 {
-  nonBlockingFileReader = NULL;
+  reader = NULL;
   ringBuffer = NULL;
   marks = NULL;
   index = NULL;
@@ -316,12 +216,15 @@ cDvbPlayer::cDvbPlayer(const char *FileName, bool PauseLive)
   playFrame = NULL;
   dropFrame = NULL;
   resyncAfterPause = false;
+  trickFrames = 0;
+  iFramesPerSecond = 0;
   isyslog("replay %s", FileName);
   fileName = new cFileName(FileName, false, false, isPesRecording);
   replayFile = fileName->Open();
   if (!replayFile)
      return;
   ringBuffer = new cRingBufferFrame(PLAYERBUFSIZE);
+  reader = new cRecordingReader(FileName, isPesRecording);
   // Create the index file:
   index = new cIndexFile(FileName, false, isPesRecording, pauseLive);
   if (!index)
@@ -339,6 +242,7 @@ cDvbPlayer::~cDvbPlayer()
   Save();
   Detach();
   delete readFrame; // might not have been stored in the buffer in Action()
+  delete reader;
   delete index;
   delete fileName;
   delete ringBuffer;
@@ -370,11 +274,38 @@ void cDvbPlayer::TrickSpeed(int Increment)
      }
 }
 
+int cDvbPlayer::GetNextTrickFrame(int Index, uint16_t *FileNumber, off_t *FileOffset, int *Length)
+{
+  int d = int(round(0.4 * framesPerSecond));
+  if (playDir != pdForward)
+     d = -d;
+  int NewIndex = Index + d;
+  if (NewIndex <= 0 && Index > 0)
+     NewIndex = 1; // make sure the very first frame is delivered
+  return index->GetNextIFrame(NewIndex, playDir == pdForward, FileNumber, FileOffset, Length);
+}
+
+void cDvbPlayer::TrickReadAhead(int Index)
+{
+  // Reading the I-frames one by one, each only after the previous one has
+  // been delivered, would make fast forward/rewind stutter on slow storage:
+  for (int i = 0; i < TRICKREADAHEAD; i++) {
+      uint16_t FileNumber;
+      off_t FileOffset;
+      int Length;
+      Index = GetNextTrickFrame(Index, &FileNumber, &FileOffset, &Length);
+      if (Index < 0 || Length <= 0 || Length > MAXFRAMESIZE)
+         break;
+      if (!reader->Prefetch(FileNumber, FileOffset, Length))
+         break;
+      }
+}
+
 void cDvbPlayer::Empty(void)
 {
   LOCK_THREAD;
-  if (nonBlockingFileReader)
-     nonBlockingFileReader->Clear();
+  if (reader)
+     reader->Clear();
   if (!firstPacket) // don't set the readIndex twice if Empty() is called more than once
      readIndex = ptsIndex.FindIndex(DeviceGetSTC()) - 1;  // Action() will first increment it!
   delete readFrame; // might not have been stored in the buffer in Action()
@@ -470,8 +401,8 @@ void cDvbPlayer::Action(void)
   if (readIndex > 0) // will first be incremented in the loop!
      --readIndex;
 
-  nonBlockingFileReader = new cNonBlockingFileReader;
   int Length = 0;
+  off_t ReadOffset = 0; // only used if there is no index
   bool Sleep = false;
   bool WaitingForData = false;
   time_t StuckAtEof = 0;
@@ -485,7 +416,7 @@ void cDvbPlayer::Action(void)
      Goto(0, true);
   while (Running()) {
         if (WaitingForData)
-           WaitingForData = !nonBlockingFileReader->WaitForDataMs(3); // this keeps the CPU load low, but reacts immediately on new data
+           WaitingForData = !reader->WaitForDataMs(3); // this keeps the CPU load low, but reacts immediately on new data
         else if (Sleep) {
            cPoller Poller;
            DevicePoll(Poller, 10);
@@ -500,29 +431,27 @@ void cDvbPlayer::Action(void)
 
           if (playMode != pmStill && playMode != pmPause) {
              if (!readFrame && (replayFile || readIndex >= 0)) {
-                if (!nonBlockingFileReader->Reading() && !AtLastMark) {
+                if (!reader->Reading() && !AtLastMark) {
+                   uint16_t FileNumber = fileName->Number();
+                   off_t FileOffset = index ? -1 : ReadOffset; // stays -1 if there is no frame to read (yet)
+                   bool ReadAhead = false;
+                   bool ReadAheadIFrames = false;
                    if (!SwitchToPlayFrame && (playMode == pmFast || (playMode == pmSlow && playDir == pdBackward))) {
-                      uint16_t FileNumber;
-                      off_t FileOffset;
                       bool TimeShiftMode = index->IsStillRecording();
                       int Index = -1;
                       readIndependent = false;
                       if (DeviceHasIBPTrickSpeed() && playDir == pdForward) {
                          if (index->Get(readIndex + 1, &FileNumber, &FileOffset, &readIndependent, &Length))
                             Index = readIndex + 1;
+                         ReadAhead = true;
                          }
                       else {
-                         int d = int(round(0.4 * framesPerSecond));
-                         if (playDir != pdForward)
-                            d = -d;
-                         int NewIndex = readIndex + d;
-                         if (NewIndex <= 0 && readIndex > 0)
-                            NewIndex = 1; // make sure the very first frame is delivered
-                         NewIndex = index->GetNextIFrame(NewIndex, playDir == pdForward, &FileNumber, &FileOffset, &Length);
+                         int NewIndex = GetNextTrickFrame(readIndex, &FileNumber, &FileOffset, &Length);
                          if (NewIndex < 0 && TimeShiftMode && playDir == pdForward)
                             SwitchToPlayFrame = readIndex;
                          Index = NewIndex;
                          readIndependent = true;
+                         ReadAheadIFrames = true;
                          }
                       if (Index >= 0) {
                          readIndex = Index;
@@ -533,10 +462,9 @@ void cDvbPlayer::Action(void)
                          eof = true;
                       }
                    else if (index) {
-                      uint16_t FileNumber;
-                      off_t FileOffset;
                       if (index->Get(readIndex + 1, &FileNumber, &FileOffset, &readIndependent, &Length) && NextFile(FileNumber, FileOffset)) {
                          readIndex++;
+                         ReadAhead = true;
                          if ((Setup.SkipEdited || Setup.PauseAtLastMark) && marks) {
                             cStateKey StateKey;
                             marks->Lock(StateKey);
@@ -572,14 +500,21 @@ void cDvbPlayer::Action(void)
                       esyslog("ERROR: frame larger than buffer (%d > %d)", Length, MAXFRAMESIZE);
                       Length = MAXFRAMESIZE;
                       }
-                   if (!eof)
-                      nonBlockingFileReader->Request(replayFile, Length);
+                   if (!eof && FileOffset >= 0) {
+                      reader->Request(FileNumber, FileOffset, Length);
+                      if (ReadAhead)
+                         reader->ReadAhead(index, readIndex + 1);
+                      else if (ReadAheadIFrames)
+                         TrickReadAhead(readIndex);
+                      }
                    }
                 if (!eof) {
                    uchar *b = NULL;
-                   int r = nonBlockingFileReader->Result(&b);
+                   int r = reader->Result(&b);
                    if (r > 0) {
                       WaitingForData = false;
+                      if (!index)
+                         ReadOffset += r;
                       LastReadFrame = readIndex;
                       uint32_t Pts = isPesRecording ? (PesHasPts(b) ? PesGetPts(b) : -1) : TsGetPts(b, r);
                       readFrame = new cFrame(b, -r, ftUnknown, readIndex, Pts, readIndependent); // hands over b to the ringBuffer
@@ -666,6 +601,8 @@ void cDvbPlayer::Action(void)
                    Sleep = true;
                 }
              if (pc <= 0) {
+                if (playFrame->Independent())
+                   trickFrames++;
                 dropFrame = playFrame;
                 playFrame = NULL;
                 p = NULL;
@@ -683,6 +620,21 @@ void cDvbPlayer::Action(void)
              Sleep = true;
              }
 
+          // Measure the rate at which I-frames are delivered in trick mode:
+
+          if (playMode == pmFast || (playMode == pmSlow && playDir == pdBackward)) {
+             if (trickTimer.Elapsed() >= TRICKSTATSINTERVAL) {
+                iFramesPerSecond = trickFrames * 1000.0 / trickTimer.Elapsed();
+                trickFrames = 0;
+                trickTimer.Set();
+                }
+             }
+          else {
+             iFramesPerSecond = 0;
+             trickFrames = 0;
+             trickTimer.Set();
+             }
+
           // Handle hitting begin/end of recording:
 
           if (eof || SwitchToPlayFrame) {
@@ -716,10 +668,6 @@ void cDvbPlayer::Action(void)
              }
         }
         }
-
-  cNonBlockingFileReader *nbfr = nonBlockingFileReader;
-  nonBlockingFileReader = NULL;
-  delete nbfr;
 }
 
 void cDvbPlayer::Pause(void)
@@ -1068,6 +1016,13 @@ bool cDvbPlayerControl::GetReplayMode(bool &Play, bool &Forward, int &Speed)
   return player && player->GetReplayMode(Play, Forward, Speed);
 }
 
+double cDvbPlayerControl::IFramesPerSecond(void)
+{
+  if (player)
+     return player->IFramesPerSecond();
+  return 0;
+}
+
 void cDvbPlayerControl::Goto(int Position, bool Still)
 {
   if (player)
@@ -60,6 +60,10 @@ public:
        // we are going forward or backward and 'Speed' is -1 if this is normal
        // play/pause mode, 0 if it is single speed fast/slow forward/back mode
        // and >0 if this is multi speed mode.
+  double IFramesPerSecond(void);
+       // Returns the number of I-frames per second that have actually been
+       // delivered to the device in fast forward/rewind mode, as measured over
+       // the last second. Returns 0 if not in such a mode.
   void Goto(int Index, bool Still = false);
        // Positions to the given index and displays that frame as a still picture
        // if Still is true. If Still is false, Play() will be called.
@@ -3086,9 +3086,7 @@ void cMenuRecordings::SetHelpKeys(void)
 
 void cMenuRecordings::Set(bool Refresh)
 {
-  if (cRecordings::GetRecordingsRead(recordingsStateKey)) {
-     recordingsStateKey.Remove();
-     cRecordings *Recordings = cRecordings::GetRecordingsWrite(recordingsStateKey); // write access is necessary for sorting!
+  if (const cRecordings *Recordings = cRecordings::GetRecordingsRead(recordingsStateKey)) {
      const char *CurrentRecording = NULL;
      if (cMenuRecordingItem *ri = (cMenuRecordingItem *)Get(Current()))
         CurrentRecording = ri->Recording()->FileName();
@@ -3097,10 +3095,11 @@ void cMenuRecordings::Set(bool Refresh)
      int current = Current();
      Clear();
      GetRecordingsSortMode(DirectoryName());
-     Recordings->Sort();
+     const cVector<const cRecording *> &SortedRecordings = Recordings->Sorted();
      cMenuRecordingItem *CurrentItem = NULL;
      cMenuRecordingItem *LastItem = NULL;
-     for (const cRecording *Recording = Recordings->First(); Recording; Recording = Recordings->Next(Recording)) {
+     for (int i = 0; i < SortedRecordings.Size(); i++) {
+         const cRecording *Recording = SortedRecordings[i];
          if ((!filter || filter->Filter(Recording)) && (!base || (strstr(Recording->Name(), base) == Recording->Name() && Recording->Name()[strlen(base)] == FOLDERDELIMCHAR))) {
             cMenuRecordingItem *Item = new cMenuRecordingItem(Recording, level);
             cMenuRecordingItem *LastDir = NULL;
@@ -3137,7 +3136,7 @@ void cMenuRecordings::Set(bool Refresh)
      if (Current() < 0)
         SetCurrent(Get(current)); // last resort, in case the recording was deleted
      SetMenuSortMode(RecordingsSortMode == rsmName ? msmName : msmTime);
-     recordingsStateKey.Remove(false); // sorting doesn't count as a real modification
+     recordingsStateKey.Remove();
      if (Refresh)
         Display();
      }
@@ -3756,6 +3755,8 @@ void cMenuSetupDVB::Setup(void)
      Add(new cMenuEditStraItem(tr("Setup.DVB$Video display format"), &data.VideoDisplayFormat, 3, videoDisplayFormatTexts));
   Add(new cMenuEditBoolItem(tr("Setup.DVB$Use Dolby Digital"),     &data.UseDolbyDigital));
   Add(new cMenuEditStraItem(tr("Setup.DVB$Update channels"),       &data.UpdateChannels, 6, updateChannelsTexts));
+  Add(new cMenuEditIntItem( tr("Setup.DVB$TS buffer delay (ms)"),  &data.TsBufferDelay, 0, 100));
+  Add(new cMenuEditIntItem( tr("Setup.DVB$TS buffer large read (KB)"), &data.TsBufferLargeRead, 0, 1024));
   Add(new cMenuEditIntItem( tr("Setup.DVB$Audio languages"),       &numAudioLanguages, 0, I18nLanguages()->Size()));
   for (int i = 0; i < numAudioLanguages; i++)
       Add(new cMenuEditStraItem(tr("Setup.DVB$Audio language"),    &data.AudioLanguages[i], I18nLanguages()->Size(), &I18nLanguages()->At(0)));
@@ -4167,6 +4168,7 @@ cMenuSetupRecord::cMenuSetupRecord(void)
   Add(new cMenuEditIntItem( tr("Setup.Recording$Max. video file size (MB)"), &data.MaxVideoFileSize, MINVIDEOFILESIZE, MAXVIDEOFILESIZETS));
   Add(new cMenuEditBoolItem(tr("Setup.Recording$Split edited files"),        &data.SplitEditedFiles));
   Add(new cMenuEditStraItem(tr("Setup.Recording$Delete timeshift recording"),&data.DelTimeshiftRec, 3, delTimeshiftRecTexts));
+  Add(new cMenuEditIntItem( tr("Setup.Recording$Directory scan threads"),   &data.VideoDirScanThreads, 1, MAXVIDEODIRSCANTHREADS));
 }
 
 // --- cMenuSetupReplay ------------------------------------------------------
@@ -5401,6 +5403,11 @@ bool cRecordControl::GetEvent(void)
 void cRecordControl::Stop(bool ExecuteUserCommand)
 {
   if (timer) {
+     if (recorder) {
+        device->Detach(recorder); // makes sure the recorder's thread has ended
+        LOCK_RECORDINGS_WRITE;
+        Recordings->SetRecordingSize(fileName, recorder->NumFrames(), recorder->FileSizeMB());
+        }
      DELETENULL(recorder);
      timer->SetRecording(false);
      timer = NULL;
@@ -21,6 +21,7 @@ cReceiver::cReceiver(const cChannel *Channel, int Priority)
   scramblingTimeout = 0;
   startEitInjection = 0;
   lastEitInjection = 0;
+  batchReceive = false;
   SetPids(Channel);
 }
 
@@ -45,8 +46,10 @@ bool cReceiver::AddPid(int Pid)
      if (numPids < MAXRECEIVEPIDS) {
         if (!WantsPid(Pid)) {
            pids[numPids++] = Pid;
-           if (device)
+           if (device) {
               device->AddPid(Pid);
+              device->ReceiversChanged();
+              }
            }
         }
      else {
@@ -95,8 +98,10 @@ void cReceiver::DelPid(int Pid)
             for ( ; i < numPids; i++) // we also copy the terminating 0!
                 pids[i] = pids[i + 1];
             numPids--;
-            if (device)
+            if (device) {
                device->DelPid(Pid);
+               device->ReceiversChanged();
+               }
             return;
             }
          }
@@ -111,6 +116,12 @@ void cReceiver::DelPids(const int *Pids)
      }
 }
 
+void cReceiver::ReceiveBatch(const uchar *Data[], int Count)
+{
+  for (int i = 0; i < Count; i++)
+      Receive(Data[i], TS_SIZE);
+}
+
 bool cReceiver::WantsPid(int Pid)
 {
   if (Pid) {
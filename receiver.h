@@ -27,10 +27,15 @@ private:
   int scramblingTimeout;
   time_t startEitInjection;
   time_t lastEitInjection;
+  bool batchReceive;
   bool WantsPid(int Pid);
 protected:
   cDevice *Device(void) { return device; }
   void Detach(void);
+  void SetBatchReceive(bool On = true) { batchReceive = On; }
+               ///< If On is true, the cDevice this receiver is attached to will deliver
+               ///< the TS packets through ReceiveBatch() instead of Receive().
+               ///< This should be called from the derived class's constructor.
   virtual void Activate(bool On) {}
                ///< This function is called just before the cReceiver gets attached to
                ///< (On == true) and right after it gets detached from (On == false) a cDevice. It can be used
@@ -43,6 +48,14 @@ protected:
                ///< as soon as possible, without any unnecessary delay. Each TS packet
                ///< will be delivered only ONCE, so the cReceiver must make sure that
                ///< it will be able to buffer the data if necessary.
+  virtual void ReceiveBatch(const uchar *Data[], int Count);
+               ///< This function is called instead of Receive() if SetBatchReceive() has
+               ///< been called, and delivers Count TS packets at once. Each of Data[0]...
+               ///< Data[Count - 1] points to exactly TS_SIZE bytes. Consecutive packets
+               ///< typically directly follow each other in memory (Data[i + 1] == Data[i] + TS_SIZE),
+               ///< so a derived class can handle such runs of packets in one go.
+               ///< The same rules as for Receive() apply. The default implementation
+               ///< calls Receive() for each packet.
 public:
   cReceiver(const cChannel *Channel = NULL, int Priority = MINPRIORITY);
                ///< Creates a new receiver for the given Channel with the given Priority.
@@ -34,6 +34,7 @@ cRecorder::cRecorder(const char *FileName, const cChannel *Channel, int Priority
   ringBuffer = new cRingBufferLinear(RECORDERBUFSIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE, true, "Recorder");
   ringBuffer->SetTimeouts(0, 100);
   ringBuffer->SetIoThrottle();
+  SetBatchReceive();
 
   int Pid = Channel->Vpid();
   int Type = Channel->Vtype();
@@ -48,7 +49,11 @@ cRecorder::cRecorder(const char *FileName, const cChannel *Channel, int Priority
   frameDetector = new cFrameDetector(Pid, Type);
   index = NULL;
   fileSize = 0;
+  initialSizeMB = max(DirSizeMB(FileName), 0); // in case we continue an existing recording
+  bytesWritten = 0;
   lastDiskSpaceCheck = time(NULL);
+  lastSizeUpdate = 0;
+  writeCalls = writeSyscalls = 0;
   fileName = new cFileName(FileName, true);
   int PatVersion, PmtVersion;
   if (fileName->GetLastPatPmtVersions(PatVersion, PmtVersion))
@@ -57,6 +62,7 @@ cRecorder::cRecorder(const char *FileName, const cChannel *Channel, int Priority
   recordFile = fileName->Open();
   if (!recordFile)
      return;
+  recordFile->SetAsyncWrite(true);
   // Create the index file:
   index = new cIndexFile(FileName, true);
   if (!index)
@@ -67,6 +73,9 @@ cRecorder::cRecorder(const char *FileName, const cChannel *Channel, int Priority
 cRecorder::~cRecorder()
 {
   Detach();
+  FinishFile();
+  if (writeCalls)
+     dsyslog("recording '%s': %d write calls, %d write syscalls", recordingName, writeCalls, writeSyscalls);
   delete index;
   delete fileName;
   delete frameDetector;
@@ -74,6 +83,49 @@ cRecorder::~cRecorder()
   free(recordingName);
 }
 
+void cRecorder::WriteIndex(void)
+{
+  // Index entries are only written once the data they refer to has actually been
+  // written to the file, so that a reader never gets an entry that points beyond
+  // the end of the file:
+  if (index && recordFile) {
+     off_t DataWritten = recordFile->DataWritten();
+     while (pendingIndex.Size() > 0) {
+           off_t Entry = pendingIndex[0];
+           off_t Offset = Entry >> 1;
+           if (Offset > DataWritten) // the previous frame hasn't been written completely
+              break;
+           index->Write(Entry & 1, fileName->Number(), Offset);
+           pendingIndex.Remove(0);
+           }
+     }
+}
+
+bool cRecorder::FinishFile(void)
+{
+  bool Result = true;
+  if (recordFile) {
+     if (!recordFile->SetAsyncWrite(false)) { // makes sure all data has been written
+        LOG_ERROR_STR(fileName->Name());
+        Result = false;
+        }
+     WriteIndex();
+     pendingIndex.Clear();
+     writeCalls += recordFile->WriteCalls();
+     writeSyscalls += recordFile->WriteSyscalls();
+     recordFile = NULL;
+     }
+  return Result;
+}
+
+void cRecorder::UpdateRecordingSize(void)
+{
+  if (index) {
+     cRecordings::UpdateRecordingSize(recordingName, NumFrames(), FileSizeMB());
+     lastSizeUpdate = time(NULL);
+     }
+}
+
 bool cRecorder::RunningLowOnDiskSpace(void)
 {
   if (time(NULL) > lastDiskSpaceCheck + DISKCHECKINTERVAL) {
@@ -91,7 +143,11 @@ bool cRecorder::NextFile(void)
 {
   if (recordFile && frameDetector->IndependentFrame()) { // every file shall start with an independent frame
      if (fileSize > MEGABYTE(off_t(Setup.MaxVideoFileSize)) || RunningLowOnDiskSpace()) {
+        if (!FinishFile())
+           return false;
         recordFile = fileName->NextFile();
+        if (recordFile)
+           recordFile->SetAsyncWrite(true);
         fileSize = 0;
         }
      }
@@ -106,30 +162,35 @@ void cRecorder::Activate(bool On)
      Cancel(3);
 }
 
+static bool IsAdaptationFieldFiller(const uchar *Data)
+{
+  static const uchar aff[TS_SIZE - 4] = { 0xB7, 0x00,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF};
+  return (Data[3] & 0b00110000) == 0b00100000 && !memcmp(Data + 4, aff, sizeof(aff)); // Length is always TS_SIZE!
+}
+
 void cRecorder::Receive(const uchar *Data, int Length)
 {
   if (Running()) {
-     static const uchar aff[TS_SIZE - 4] = { 0xB7, 0x00,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-       0xFF, 0xFF}; // Length is always TS_SIZE!
-     if ((Data[3] & 0b00110000) == 0b00100000 && !memcmp(Data + 4, aff, sizeof(aff)))
+     if (IsAdaptationFieldFiller(Data))
         return; // Adaptation Field Filler found, skipping
      int p = ringBuffer->Put(Data, Length);
      if (p != Length && Running())
@@ -137,6 +198,27 @@ void cRecorder::Receive(const uchar *Data, int Length)
      }
 }
 
+void cRecorder::ReceiveBatch(const uchar *Data[], int Count)
+{
+  if (Running()) {
+     for (int i = 0; i < Count; ) {
+         if (IsAdaptationFieldFiller(Data[i])) {
+            i++;
+            continue; // Adaptation Field Filler found, skipping
+            }
+         // Put runs of packets that directly follow each other in one go:
+         int n = 1;
+         while (i + n < Count && Data[i + n] == Data[i] + n * TS_SIZE && !IsAdaptationFieldFiller(Data[i + n]))
+               n++;
+         int Length = n * TS_SIZE;
+         int p = ringBuffer->Put(Data[i], Length);
+         if (p != Length && Running())
+            ringBuffer->ReportOverflow(Length - p);
+         i += n;
+         }
+     }
+}
+
 void cRecorder::Action(void)
 {
   cTimeMs t(MAXBROKENTIMEOUT);
@@ -169,22 +251,32 @@ void cRecorder::Action(void)
                     if (!NextFile())
                        break;
                     if (index && frameDetector->NewFrame())
-                       index->Write(frameDetector->IndependentFrame(), fileName->Number(), fileSize);
+                       pendingIndex.Append(fileSize * 2 + frameDetector->IndependentFrame());
+                    // Write the PAT/PMT (if any) together with the frame data in one go:
+                    struct iovec Iov[MAX_PMT_TS + 2];
+                    int n = 0;
                     if (frameDetector->IndependentFrame()) {
-                       recordFile->Write(patPmtGenerator.GetPat(), TS_SIZE);
-                       fileSize += TS_SIZE;
+                       Iov[n].iov_base = patPmtGenerator.GetPat();
+                       Iov[n++].iov_len = TS_SIZE;
                        int Index = 0;
                        while (uchar *pmt = patPmtGenerator.GetPmt(Index)) {
-                             recordFile->Write(pmt, TS_SIZE);
-                             fileSize += TS_SIZE;
+                             Iov[n].iov_base = pmt;
+                             Iov[n++].iov_len = TS_SIZE;
                              }
                        t.Set(MAXBROKENTIMEOUT);
                        }
-                    if (recordFile->Write(b, Count) < 0) {
+                    Iov[n].iov_base = b;
+                    Iov[n++].iov_len = Count;
+                    ssize_t w = recordFile->WriteV(Iov, n);
+                    if (w < 0) {
                        LOG_ERROR_STR(fileName->Name());
                        break;
                        }
-                    fileSize += Count;
+                    fileSize += w;
+                    bytesWritten += w;
+                    WriteIndex();
+                    if (time(NULL) - lastSizeUpdate >= RECORDINGSIZEUPDATE)
+                       UpdateRecordingSize();
                     }
                  }
               ringBuffer->Del(Count);
@@ -196,4 +288,6 @@ void cRecorder::Action(void)
            t.Set(MAXBROKENTIMEOUT);
            }
         }
+  FinishFile();
+  UpdateRecordingSize();
 }
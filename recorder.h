@@ -24,9 +24,18 @@ private:
   cFileName *fileName;
   cIndexFile *index;
   cUnbufferedFile *recordFile;
+  cVector<off_t> pendingIndex; // the offsets (times 2, plus 1 for independent frames) of frames in recordFile that haven't been written to the index yet
   char *recordingName;
   off_t fileSize;
+  int initialSizeMB;
+  off_t bytesWritten;
   time_t lastDiskSpaceCheck;
+  time_t lastSizeUpdate;
+  int writeCalls;
+  int writeSyscalls;
+  void WriteIndex(void);
+  bool FinishFile(void);
+  void UpdateRecordingSize(void);
   bool RunningLowOnDiskSpace(void);
   bool NextFile(void);
 protected:
@@ -36,12 +45,17 @@ protected:
        ///< to properly get a call to Activate(false) when your object is
        ///< destroyed.
   virtual void Receive(const uchar *Data, int Length);
+  virtual void ReceiveBatch(const uchar *Data[], int Count);
   virtual void Action(void);
 public:
   cRecorder(const char *FileName, const cChannel *Channel, int Priority);
        ///< Creates a new recorder for the given Channel and
        ///< the given Priority that will record into the file FileName.
   virtual ~cRecorder();
+  int NumFrames(void) { return index ? index->Last() + 1 : -1; }
+       ///< Returns the number of frames recorded so far.
+  int FileSizeMB(void) { return initialSizeMB + int(bytesWritten / MEGABYTE(1)); }
+       ///< Returns the total size of the recording's files (in MB) so far.
   };
 
 #endif //__RECORDER_H
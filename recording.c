@@ -17,6 +17,10 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "channels.h"
@@ -67,7 +71,10 @@
 #define REMOVELATENCY      10 // seconds to wait until next check after removing a file
 #define MARKSUPDATEDELTA   10 // seconds between checks for updating editing marks
 #define MININDEXAGE      3600 // seconds before an index file is considered no longer to be written
-#define MAXREMOVETIME      10 // seconds after which to return from removing deleted recordings
+#define RECLAIMSTEPMB     128 // MB to free with each step when removing a deleted recording
+#define RECLAIMSTEPDELAY  100 // ms to wait between two steps of removing a deleted recording
+#define RECLAIMWAIT      1000 // ms to wait for new deleted recordings to be removed
+#define RECLAIMLOCKWAIT 10000 // ms to wait before trying again if another instance of VDR is removing recordings
 
 #define MAX_LINK_LEVEL  6
 
@@ -78,75 +85,17 @@ int DirectoryNameMax = NAME_MAX;
 bool DirectoryEncoding = false;
 int InstanceId = 0;
 
-// --- cRemoveDeletedRecordingsThread ----------------------------------------
-
-class cRemoveDeletedRecordingsThread : public cThread {
-protected:
-  virtual void Action(void);
-public:
-  cRemoveDeletedRecordingsThread(void);
-  };
-
-cRemoveDeletedRecordingsThread::cRemoveDeletedRecordingsThread(void)
-:cThread("remove deleted recordings", true)
-{
-}
-
-void cRemoveDeletedRecordingsThread::Action(void)
-{
-  // Make sure only one instance of VDR does this:
-  cLockFile LockFile(cVideoDirectory::Name());
-  if (LockFile.Lock()) {
-     time_t StartTime = time(NULL);
-     bool deleted = false;
-     bool interrupted = false;
-     LOCK_DELETEDRECORDINGS_WRITE;
-     for (cRecording *r = DeletedRecordings->First(); r; ) {
-         if (cIoThrottle::Engaged())
-            interrupted = true;
-         else if (time(NULL) - StartTime > MAXREMOVETIME)
-            interrupted = true; // don't stay here too long
-         else if (cRemote::HasKeys())
-            interrupted = true; // react immediately on user input
-         if (interrupted)
-            break;
-         if (r->Deleted() && time(NULL) - r->Deleted() > DELETEDLIFETIME) {
-            cRecording *next = DeletedRecordings->Next(r);
-            r->Remove();
-            DeletedRecordings->Del(r);
-            r = next;
-            deleted = true;
-            }
-         else
-            r = DeletedRecordings->Next(r);
-         }
-     if (deleted) {
-        cRecordings::TouchUpdate();
-        if (!interrupted) {
-           const char *IgnoreFiles[] = { SORTMODEFILE, TIMERRECFILE, NULL };
-           cVideoDirectory::RemoveEmptyVideoDirectories(IgnoreFiles);
-           }
-        }
-     }
-}
-
-static cRemoveDeletedRecordingsThread RemoveDeletedRecordingsThread;
-
 // ---
 
 void RemoveDeletedRecordings(void)
 {
   static time_t LastRemoveCheck = 0;
   if (time(NULL) - LastRemoveCheck > REMOVECHECKDELTA) {
-     if (!RemoveDeletedRecordingsThread.Active()) {
-        LOCK_DELETEDRECORDINGS_READ;
-        for (const cRecording *r = DeletedRecordings->First(); r; r = DeletedRecordings->Next(r)) {
-            if (r->Deleted() && time(NULL) - r->Deleted() > DELETEDLIFETIME) {
-               RemoveDeletedRecordingsThread.Start();
-               break;
-               }
-            }
-        }
+     LOCK_DELETEDRECORDINGS_READ;
+     for (const cRecording *r = DeletedRecordings->First(); r; r = DeletedRecordings->Next(r)) {
+         if (r->Deleted() && time(NULL) - r->Deleted() > DELETEDLIFETIME)
+            RecordingsHandler.Remove(r->FileName(), r->FileSizeMB());
+         }
      LastRemoveCheck = time(NULL);
      }
 }
@@ -170,24 +119,27 @@ void AssertFreeDiskSpace(int Priority, bool Force)
         isyslog("low disk space while recording, trying to remove a deleted recording...");
         int NumDeletedRecordings = 0;
         {
-          LOCK_DELETEDRECORDINGS_WRITE;
+          LOCK_DELETEDRECORDINGS_READ;
           NumDeletedRecordings = DeletedRecordings->Count();
           if (NumDeletedRecordings) {
-             cRecording *r = DeletedRecordings->First();
-             cRecording *r0 = NULL;
+             const cRecording *r = DeletedRecordings->First();
+             const cRecording *r0 = NULL;
+             bool Reclaiming = false;
              while (r) {
                    if (r->IsOnVideoDirectoryFileSystem()) { // only remove recordings that will actually increase the free video disk space
-                      if (!r0 || r->Start() < r0->Start())
+                      if ((RecordingsHandler.GetUsage(r->FileName()) & ruRemove) != 0)
+                         Reclaiming = true;
+                      else if (!r0 || r->Start() < r0->Start())
                          r0 = r;
                       }
                    r = DeletedRecordings->Next(r);
                    }
-             if (r0) {
-                if (r0->Remove())
-                   LastFreeDiskCheck += REMOVELATENCY / Factor;
-                DeletedRecordings->Del(r0);
+             if (r0 && RecordingsHandler.Remove(r0->FileName(), r0->FileSizeMB())) {
+                LastFreeDiskCheck += REMOVELATENCY / Factor;
                 return;
                 }
+             if (Reclaiming)
+                return; // disk space is already being freed, so let's not delete any recordings
              }
         }
         if (NumDeletedRecordings == 0) {
@@ -759,12 +711,16 @@ char *LimitNameLengths(char *s, int PathMax, int NameMax)
   return s;
 }
 
+int cRecording::fileNameChanges = 0;
+int cRecording::sizeChanges = 0;
+
 cRecording::cRecording(cTimer *Timer, const cEvent *Event)
 {
   id = 0;
   resume = RESUME_NOT_INITIALIZED;
   titleBuffer = NULL;
   sortBufferName = sortBufferTime = NULL;
+  sortNameVersion = 0;
   fileName = NULL;
   name = NULL;
   fileSizeMB = -1; // unknown
@@ -816,6 +772,16 @@ cRecording::cRecording(cTimer *Timer, const cEvent *Event)
 }
 
 cRecording::cRecording(const char *FileName)
+{
+  Initialize(FileName, NULL);
+}
+
+cRecording::cRecording(const char *FileName, FILE *InfoFile)
+{
+  Initialize(FileName, InfoFile);
+}
+
+void cRecording::Initialize(const char *FileName, FILE *InfoFile)
 {
   id = 0;
   resume = RESUME_NOT_INITIALIZED;
@@ -831,6 +797,7 @@ cRecording::cRecording(const char *FileName)
   deleted = 0;
   titleBuffer = NULL;
   sortBufferName = sortBufferTime = NULL;
+  sortNameVersion = 0;
   FileName = fileName = strdup(FileName);
   if (*(fileName + strlen(fileName) - 1) == '/')
      *(fileName + strlen(fileName) - 1) = 0;
@@ -859,10 +826,11 @@ cRecording::cRecording(const char *FileName)
         }
      else
         return;
-     GetResume();
+     if (!InfoFile)
+        GetResume(); // a cached recording reads the resume file on demand
      // read an optional info file:
      cString InfoFileName = cString::sprintf("%s%s", fileName, isPesRecording ? INFOFILESUFFIX ".vdr" : INFOFILESUFFIX);
-     FILE *f = fopen(InfoFileName, "r");
+     FILE *f = InfoFile ? InfoFile : fopen(InfoFileName, "r");
      if (f) {
         if (!info->Read(f))
            esyslog("ERROR: EPG data problem in file %s", *InfoFileName);
@@ -871,7 +839,8 @@ cRecording::cRecording(const char *FileName)
            lifetime = info->lifetime;
            framesPerSecond = info->framesPerSecond;
            }
-        fclose(f);
+        if (!InfoFile)
+           fclose(f);
         }
      else if (errno != ENOENT)
         LOG_ERROR_STR(*InfoFileName);
@@ -981,9 +950,14 @@ char *cRecording::StripEpisodeName(char *s, bool Strip)
 
 char *cRecording::SortName(void) const
 {
-  char **sb = (RecordingsSortMode == rsmName) ? &sortBufferName : &sortBufferTime;
+  return SortName(RecordingsSortMode);
+}
+
+char *cRecording::SortName(eRecordingsSortMode SortMode) const
+{
+  char **sb = (SortMode == rsmName) ? &sortBufferName : &sortBufferTime;
   if (!*sb) {
-     if (RecordingsSortMode == rsmTime && !Setup.RecordingDirs) {
+     if (SortMode == rsmTime && !Setup.RecordingDirs) {
         char buf[32];
         struct tm tm_r;
         strftime(buf, sizeof(buf), "%Y%m%d%H%I", localtime_r(&start, &tm_r));
@@ -991,8 +965,8 @@ char *cRecording::SortName(void) const
         }
      else {
         char *s = strdup(FileName() + strlen(cVideoDirectory::Name()));
-        if (RecordingsSortMode != rsmName || Setup.AlwaysSortFoldersFirst)
-           s = StripEpisodeName(s, RecordingsSortMode != rsmName);
+        if (SortMode != rsmName || Setup.AlwaysSortFoldersFirst)
+           s = StripEpisodeName(s, SortMode != rsmName);
         strreplace(s, '/', (Setup.RecSortingDirection == rsdAscending) ? '0' : '1'); // some locales ignore '/' when sorting
         int l = strxfrm(NULL, s, 0) + 1;
         *sb = MALLOC(char, l);
@@ -1008,6 +982,7 @@ void cRecording::ClearSortName(void)
   free(sortBufferName);
   free(sortBufferTime);
   sortBufferName = sortBufferTime = NULL;
+  sortNameVersion++;
 }
 
 void cRecording::SetId(int Id)
@@ -1215,6 +1190,8 @@ bool cRecording::ChangePriorityLifetime(int NewPriority, int NewLifetime)
         lifetime = NewLifetime;
         free(fileName);
         fileName = NULL;
+        FileNameChanged();
+        ClearSortName();
         cString NewFileName = FileName();
         if (!cVideoDirectory::RenameVideoFile(OldFileName, NewFileName))
            return false;
@@ -1238,6 +1215,7 @@ bool cRecording::ChangeName(const char *NewName)
      cString OldFileName = FileName();
      free(fileName);
      fileName = NULL;
+     FileNameChanged();
      free(name);
      name = strdup(NewName);
      cString NewFileName = FileName();
@@ -1252,6 +1230,7 @@ bool cRecording::ChangeName(const char *NewName)
         return false;
         }
      isOnVideoDirectoryFileSystem = -1; // it might have been moved to a different file system
+     SizeChanged();
      ClearSortName();
      }
   return true;
@@ -1306,6 +1285,11 @@ bool cRecording::Undelete(void)
         esyslog("ERROR: attempt to undelete '%s', while recording '%s' exists", FileName(), NewName);
         result = false;
         }
+     else if ((RecordingsHandler.GetUsage(FileName()) & ruRemove) != 0) {
+        // the files may already have been truncated:
+        esyslog("ERROR: attempt to undelete '%s', while it is being removed", FileName());
+        result = false;
+        }
      else {
         isyslog("undeleting recording '%s'", FileName());
         if (access(FileName(), F_OK) == 0)
@@ -1343,6 +1327,7 @@ int cRecording::NumFrames(void) const
      if (time(NULL) - LastModifiedTime(cIndexFile::IndexFileName(FileName(), IsPesRecording())) < MININDEXAGE)
         return nf; // check again later for ongoing recordings
      numFrames = nf;
+     SizeChanged();
      }
   return numFrames;
 }
@@ -1362,19 +1347,236 @@ int cRecording::FileSizeMB(void) const
      if (time(NULL) - LastModifiedTime(cIndexFile::IndexFileName(FileName(), IsPesRecording())) < MININDEXAGE)
         return fs; // check again later for ongoing recordings
      fileSizeMB = fs;
+     SizeChanged();
      }
   return fileSizeMB;
 }
 
+// --- cRecordingsCache ------------------------------------------------------
+
+// The recordings cache file starts with a line containing its version, followed
+// by one entry per recording. Each entry consists of a line with the modification
+// time of the recording's directory, the number of frames, the file size (in MB)
+// and the full path name of the recording, followed by the recording's info data
+// (in the same format as the info file) and a line containing only a '.'.
+
+#define RECORDINGSCACHEVERSION 1
+
+static unsigned int HashString(const char *s)
+{
+  unsigned int h = 0;
+  while (*s)
+        h = h * 31 + uchar(*s++);
+  return h;
+}
+
+class cRecordingsCacheEntry : public cListObject {
+public:
+  const char *fileName;
+  time_t modified;
+  int numFrames;
+  int fileSizeMB;
+  const char *info;
+  int infoLength;
+  };
+
+class cRecordingsCache {
+private:
+  const char *fileName;
+  char *data;
+  cList<cRecordingsCacheEntry> entries;
+  cHash<cRecordingsCacheEntry> entriesByName;
+  cSafeFile *safeFile;
+  bool Parse(char *Data, int Length);
+public:
+  cRecordingsCache(const char *FileName);
+  ~cRecordingsCache();
+  void Load(void);
+       ///< Loads the entries of the cache file.
+  cRecording *GetRecording(const char *FileName, time_t Modified);
+       ///< Returns a new cRecording with the cached data of the recording with the
+       ///< given FileName, or NULL if there is no such entry, or the recording's
+       ///< directory has been modified since the entry was written.
+  void Open(void);
+       ///< Starts writing a new cache file.
+  void Add(const cRecording *Recording, time_t Modified);
+       ///< Adds the given Recording, the directory of which was last modified at
+       ///< the given time, to the new cache file.
+  void Close(void);
+       ///< Finishes writing the new cache file.
+  };
+
+cRecordingsCache::cRecordingsCache(const char *FileName)
+:entriesByName(HASHSIZE * 4)
+{
+  fileName = FileName;
+  data = NULL;
+  safeFile = NULL;
+}
+
+cRecordingsCache::~cRecordingsCache()
+{
+  delete safeFile;
+  free(data);
+}
+
+void cRecordingsCache::Load(void)
+{
+  if (fileName && access(fileName, F_OK) == 0) {
+     int f = open(fileName, O_RDONLY);
+     if (f >= 0) {
+        struct stat st;
+        if (fstat(f, &st) == 0 && (data = MALLOC(char, st.st_size + 1)) != NULL) {
+           if (safe_read(f, data, st.st_size) == st.st_size) {
+              data[st.st_size] = 0;
+              if (Parse(data, st.st_size))
+                 dsyslog("loaded %d entries from %s", entries.Count(), fileName);
+              else
+                 esyslog("ERROR: invalid recordings cache file %s", fileName);
+              }
+           else
+              LOG_ERROR_STR(fileName);
+           }
+        close(f);
+        }
+     else
+        LOG_ERROR_STR(fileName);
+     }
+}
+
+bool cRecordingsCache::Parse(char *Data, int Length)
+{
+  char *End = Data + Length;
+  int Version = 0;
+  if (sscanf(Data, "V %d", &Version) != 1 || Version != RECORDINGSCACHEVERSION)
+     return false;
+  char *s = strchr(Data, '\n');
+  while (s && ++s < End) {
+        // the header line of an entry:
+        char *e = strchr(s, '\n');
+        if (!e)
+           return false;
+        *e = 0;
+        cRecordingsCacheEntry *Entry = new cRecordingsCacheEntry;
+        long Modified;
+        int n = 0;
+        if (sscanf(s, "%ld %d %d %n", &Modified, &Entry->numFrames, &Entry->fileSizeMB, &n) != 3 || !n) {
+           delete Entry;
+           return false;
+           }
+        Entry->modified = Modified;
+        Entry->fileName = s + n;
+        // the info data, up to the line containing only a '.':
+        Entry->info = s = e + 1;
+        while (s < End && !(s[0] == '.' && s[1] == '\n')) {
+              if (!(s = strchr(s, '\n')))
+                 break;
+              s++;
+              }
+        if (!s || s >= End) {
+           delete Entry;
+           return false;
+           }
+        Entry->infoLength = s - Entry->info;
+        entries.Add(Entry);
+        entriesByName.Add(Entry, HashString(Entry->fileName));
+        s++; // points to the newline after the '.'
+        }
+  return true;
+}
+
+cRecording *cRecordingsCache::GetRecording(const char *FileName, time_t Modified)
+{
+  if (cList<cHashObject> *List = entriesByName.GetList(HashString(FileName))) {
+     for (cHashObject *hob = List->First(); hob; hob = List->Next(hob)) {
+         cRecordingsCacheEntry *Entry = (cRecordingsCacheEntry *)hob->Object();
+         if (strcmp(Entry->fileName, FileName) == 0) {
+            if (Entry->modified == Modified && Entry->infoLength > 0) {
+               if (FILE *f = fmemopen((void *)Entry->info, Entry->infoLength, "r")) {
+                  cRecording *Recording = new cRecording(FileName, f);
+                  fclose(f);
+                  if (Recording->Name()) {
+                     Recording->numFrames = Entry->numFrames;
+                     Recording->fileSizeMB = Entry->fileSizeMB;
+                     return Recording;
+                     }
+                  delete Recording;
+                  }
+               }
+            break;
+            }
+         }
+     }
+  return NULL;
+}
+
+void cRecordingsCache::Open(void)
+{
+  if (fileName) {
+     safeFile = new cSafeFile(fileName);
+     if (safeFile->Open())
+        fprintf(*safeFile, "V %d\n", RECORDINGSCACHEVERSION);
+     else
+        DELETENULL(safeFile);
+     }
+}
+
+void cRecordingsCache::Add(const cRecording *Recording, time_t Modified)
+{
+  if (safeFile) {
+     fprintf(*safeFile, "%ld %d %d %s\n", long(Modified), Recording->numFrames, Recording->fileSizeMB, Recording->FileName());
+     Recording->Info()->Write(*safeFile);
+     fprintf(*safeFile, ".\n");
+     }
+}
+
+void cRecordingsCache::Close(void)
+{
+  if (safeFile) {
+     if (!safeFile->Close())
+        esyslog("ERROR: can't write recordings cache file %s", fileName);
+     DELETENULL(safeFile);
+     }
+}
+
 // --- cVideoDirectoryScannerThread ------------------------------------------
 
+class cVideoDirectoryScanJob : public cListObject {
+public:
+  cString dirName;
+  int linkLevel;
+  cVideoDirectoryScanJob(const char *DirName, int LinkLevel) { dirName = DirName; linkLevel = LinkLevel; }
+  };
+
+class cVideoDirectoryScanResult : public cListObject {
+public:
+  cString fileName;
+  time_t modified;
+  bool deleted;
+  cRecording *recording;
+  cVideoDirectoryScanResult(const char *FileName, time_t Modified, bool Deleted) { fileName = FileName; modified = Modified; deleted = Deleted; recording = NULL; }
+  virtual ~cVideoDirectoryScanResult() { delete recording; }
+  };
+
 class cVideoDirectoryScannerThread : public cThread {
+  friend class cVideoDirectoryScanWorker;
 private:
   cRecordings *recordings;
   cRecordings *deletedRecordings;
   int count;
   bool initial;
-  void ScanVideoDir(const char *DirName, int LinkLevel = 0, int DirLevel = 0);
+  cRecordingsCache *cache;
+  cMutex mutex;
+  cCondVar jobAvailable;
+  cList<cVideoDirectoryScanJob> jobs;
+  int busy;
+  cMutex throttleMutex;
+  void Throttle(void);
+  void AddJob(const char *DirName, int LinkLevel);
+  bool CheckNames(void);
+  void Work(void);
+  void ScanVideoDir(const char *DirName, int LinkLevel);
+  void AddRecordings(cList<cVideoDirectoryScanResult> &Results);
 protected:
   virtual void Action(void);
 public:
@@ -1382,6 +1584,15 @@ public:
   ~cVideoDirectoryScannerThread();
   };
 
+class cVideoDirectoryScanWorker : public cThread {
+private:
+  cVideoDirectoryScannerThread *scanner;
+protected:
+  virtual void Action(void) { scanner->Work(); }
+public:
+  cVideoDirectoryScanWorker(cVideoDirectoryScannerThread *Scanner) : cThread("video directory scan worker", true) { scanner = Scanner; }
+  };
+
 cVideoDirectoryScannerThread::cVideoDirectoryScannerThread(cRecordings *Recordings, cRecordings *DeletedRecordings)
 :cThread("video directory scanner", true)
 {
@@ -1389,6 +1600,8 @@ cVideoDirectoryScannerThread::cVideoDirectoryScannerThread(cRecordings *Recordin
   deletedRecordings = DeletedRecordings;
   count = 0;
   initial = true;
+  cache = NULL;
+  busy = 0;
 }
 
 cVideoDirectoryScannerThread::~cVideoDirectoryScannerThread()
@@ -1406,158 +1619,799 @@ void cVideoDirectoryScannerThread::Action(void)
   deletedRecordings->Lock(StateKey, true);
   deletedRecordings->Clear();
   StateKey.Remove();
-  ScanVideoDir(cVideoDirectory::Name());
+  // The initial scan uses the recordings cache, and writes it anew:
+  cRecordingsCache RecordingsCache(cRecordings::CacheFileName());
+  if (initial && cRecordings::CacheFileName()) {
+     cache = &RecordingsCache;
+     cache->Load();
+     cache->Open();
+     }
+  // Sibling directories are scanned concurrently by a pool of workers, this
+  // thread being one of them:
+  AddJob(cVideoDirectory::Name(), 0);
+  cVector<cVideoDirectoryScanWorker *> Workers;
+  for (int i = 1; i < Setup.VideoDirScanThreads; i++) {
+      Workers.Append(new cVideoDirectoryScanWorker(this));
+      Workers[i - 1]->Start();
+      }
+  Work();
+  for (int i = 0; i < Workers.Size(); i++) {
+      while (Workers[i]->Active())
+            cCondWait::SleepMs(10);
+      delete Workers[i];
+      }
+  jobs.Clear(); // in case the scan has been canceled
+  if (cache) {
+     cache->Close();
+     cache = NULL;
+     }
+  // Handle any vanished recordings:
+  if (!initial) {
+     recordings->Lock(StateKey, true);
+     for (cRecording *Recording = recordings->First(); Recording; ) {
+         cRecording *r = Recording;
+         Recording = recordings->Next(Recording);
+         if (access(r->FileName(), F_OK) != 0)
+            recordings->Del(r);
+         }
+     StateKey.Remove();
+     }
 }
 
-void cVideoDirectoryScannerThread::ScanVideoDir(const char *DirName, int LinkLevel, int DirLevel)
+void cVideoDirectoryScannerThread::Throttle(void)
 {
-  // Find any new recordings:
-  cReadDir d(DirName);
+  if (cIoThrottle::Engaged()) {
+     cMutexLock MutexLock(&throttleMutex); // only one worker at a time continues while throttled
+     cCondWait::SleepMs(100);
+     }
+}
+
+void cVideoDirectoryScannerThread::AddJob(const char *DirName, int LinkLevel)
+{
+  cMutexLock MutexLock(&mutex);
+  jobs.Add(new cVideoDirectoryScanJob(DirName, LinkLevel));
+  jobAvailable.Broadcast();
+}
+
+bool cVideoDirectoryScannerThread::CheckNames(void)
+{
+  // The caller must hold a lock on the recordings.
+  cMutexLock MutexLock(&mutex);
+  if (initial && count != recordings->Count()) {
+     dsyslog("activated name checking for initial read of video directory");
+     initial = false;
+     }
+  return !initial;
+}
+
+void cVideoDirectoryScannerThread::Work(void)
+{
+  mutex.Lock();
+  while (Running()) {
+        while (Running() && !jobs.First() && busy)
+              jobAvailable.TimedWait(mutex, 100);
+        cVideoDirectoryScanJob *Job = jobs.First();
+        if (!Job)
+           break; // all directories have been scanned
+        jobs.Del(Job, false);
+        busy++;
+        mutex.Unlock();
+        ScanVideoDir(Job->dirName, Job->linkLevel);
+        delete Job;
+        mutex.Lock();
+        busy--;
+        }
+  jobAvailable.Broadcast();
+  mutex.Unlock();
+}
+
+void cVideoDirectoryScannerThread::ScanVideoDir(const char *DirName, int LinkLevel)
+{
+  // Find any recordings in this directory, and queue its other subdirectories:
+  cList<cVideoDirectoryScanResult> Results;
+  int DirFd = open(DirName, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (DirFd < 0)
+     return;
+  DIR *d = fdopendir(DirFd);
+  if (!d) {
+     close(DirFd);
+     return;
+     }
   struct dirent *e;
-  while (Running() && (e = d.Next()) != NULL) {
-        if (cIoThrottle::Engaged())
-           cCondWait::SleepMs(100);
-        cString buffer = AddDirectory(DirName, e->d_name);
+  while (Running() && (e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+           continue;
+        Throttle();
         struct stat st;
-        if (lstat(buffer, &st) == 0) {
+        if (fstatat(DirFd, e->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
            int Link = 0;
+           cString buffer = AddDirectory(DirName, e->d_name);
            if (S_ISLNK(st.st_mode)) {
               if (LinkLevel > MAX_LINK_LEVEL) {
                  isyslog("max link level exceeded - not scanning %s", *buffer);
                  continue;
                  }
               Link = 1;
-              if (stat(buffer, &st) != 0)
+              if (fstatat(DirFd, e->d_name, &st, 0) != 0)
                  continue;
               }
            if (S_ISDIR(st.st_mode)) {
-              cRecordings *Recordings = NULL;
               if (endswith(buffer, RECEXT))
-                 Recordings = recordings;
+                 Results.Add(new cVideoDirectoryScanResult(buffer, st.st_mtime, false));
               else if (endswith(buffer, DELEXT))
-                 Recordings = deletedRecordings;
-              if (Recordings) {
-                 cStateKey StateKey;
-                 Recordings->Lock(StateKey, true);
-                 if (initial && count != recordings->Count()) {
-                    dsyslog("activated name checking for initial read of video directory");
-                    initial = false;
-                    }
-                 if (Recordings == deletedRecordings || initial || !Recordings->GetByName(buffer)) {
-                    cRecording *r = new cRecording(buffer);
-                    if (r->Name()) {
-                       r->NumFrames(); // initializes the numFrames member
-                       r->FileSizeMB(); // initializes the fileSizeMB member
-                       r->IsOnVideoDirectoryFileSystem(); // initializes the isOnVideoDirectoryFileSystem member
-                       if (Recordings == deletedRecordings)
-                          r->SetDeleted();
-                       Recordings->Add(r);
-                       count = recordings->Count();
-                       }
-                    else
-                       delete r;
-                    }
-                 StateKey.Remove();
-                 }
+                 Results.Add(new cVideoDirectoryScanResult(buffer, st.st_mtime, true));
               else
-                 ScanVideoDir(buffer, LinkLevel + Link, DirLevel + 1);
+                 AddJob(buffer, LinkLevel + Link);
               }
            }
         }
-  // Handle any vanished recordings:
-  if (!initial && DirLevel == 0) {
-     cStateKey StateKey;
-     recordings->Lock(StateKey, true);
-     for (cRecording *Recording = recordings->First(); Recording; ) {
-         cRecording *r = Recording;
-         Recording = recordings->Next(Recording);
-         if (access(r->FileName(), F_OK) != 0)
-            recordings->Del(r);
+  closedir(d);
+  if (Results.First())
+     AddRecordings(Results);
+}
+
+void cVideoDirectoryScannerThread::AddRecordings(cList<cVideoDirectoryScanResult> &Results)
+{
+  // Skip recordings that are already known:
+  cStateKey StateKey;
+  recordings->Lock(StateKey);
+  if (CheckNames()) {
+     for (cVideoDirectoryScanResult *Result = Results.First(); Result; ) {
+         cVideoDirectoryScanResult *r = Result;
+         Result = Results.Next(Result);
+         if (!r->deleted && recordings->GetByName(r->fileName))
+            Results.Del(r);
          }
-     StateKey.Remove();
      }
+  StateKey.Remove();
+  // Reading the recordings' data is done without holding any lock:
+  bool HasDeleted = false;
+  for (cVideoDirectoryScanResult *Result = Results.First(); Result && Running(); Result = Results.Next(Result)) {
+      Throttle();
+      cRecording *r = NULL;
+      if (cache && !Result->deleted)
+         r = cache->GetRecording(Result->fileName, Result->modified);
+      if (!r)
+         r = new cRecording(Result->fileName);
+      if (r->Name()) {
+         r->NumFrames(); // initializes the numFrames member
+         r->FileSizeMB(); // initializes the fileSizeMB member
+         r->IsOnVideoDirectoryFileSystem(); // initializes the isOnVideoDirectoryFileSystem member
+         if (Result->deleted) {
+            r->SetDeleted();
+            HasDeleted = true;
+            }
+         Result->recording = r;
+         }
+      else
+         delete r;
+      }
+  // Add all recordings of this directory in one go:
+  cStateKey DeletedStateKey;
+  recordings->Lock(StateKey, true);
+  if (HasDeleted)
+     deletedRecordings->Lock(DeletedStateKey, true);
+  bool Check = CheckNames();
+  for (cVideoDirectoryScanResult *Result = Results.First(); Result; Result = Results.Next(Result)) {
+      if (cRecording *r = Result->recording) {
+         if (Result->deleted)
+            deletedRecordings->Add(r);
+         else {
+            if (Check && recordings->GetByName(r->FileName()))
+               continue; // has been added in the meantime
+            if (cache)
+               cache->Add(r, Result->modified);
+            recordings->Add(r);
+            }
+         Result->recording = NULL;
+         }
+      }
+  mutex.Lock();
+  count = recordings->Count();
+  mutex.Unlock();
+  if (HasDeleted)
+     DeletedStateKey.Remove();
+  StateKey.Remove();
 }
 
-// --- cRecordings -----------------------------------------------------------
+// --- cVideoDirectoryWatcher ------------------------------------------------
 
-cRecordings cRecordings::recordings;
-cRecordings cRecordings::deletedRecordings(true);
-int cRecordings::lastRecordingId = 0;
-char *cRecordings::updateFileName = NULL;
-cVideoDirectoryScannerThread *cRecordings::videoDirectoryScannerThread = NULL;
-time_t cRecordings::lastUpdate = 0;
+#define WATCHDIRMASK  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+#define WATCHRECMASK  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR)
 
-cRecordings::cRecordings(bool Deleted)
-:cList<cRecording>(Deleted ? "4 DelRecs" : "3 Recordings")
-{
-}
+class cVideoDirectoryWatch : public cListObject {
+public:
+  int wd;
+  cString path;
+  bool isRecording;
+  cVideoDirectoryWatch(int Wd, const char *Path, bool IsRecording) { wd = Wd; path = Path; isRecording = IsRecording; }
+  };
 
-cRecordings::~cRecordings()
+class cVideoDirectoryWatcher : public cThread {
+private:
+  int fd;
+  cList<cVideoDirectoryWatch> watches;
+  cHash<cVideoDirectoryWatch> watchesByWd;
+  cMutex mutex;
+  bool watching;
+  bool needsUpdate;
+  bool failed;
+  bool AddWatch(const char *Path, bool IsRecording);
+  void DelWatches(const char *Path);
+  void WatchDir(const char *DirName, int LinkLevel, bool Scan);
+  void Reset(void);
+  void RecordingAdded(const char *FileName);
+  void RecordingRemoved(const char *FileName);
+  void DirRemoved(const char *DirName);
+  void HandleEvent(const struct inotify_event *Event);
+protected:
+  virtual void Action(void);
+public:
+  cVideoDirectoryWatcher(void);
+  virtual ~cVideoDirectoryWatcher();
+  bool Watching(void);
+       ///< Returns true if all changes to the video directory are currently
+       ///< being tracked by this watcher.
+  bool NeedsUpdate(bool Reset = true);
+       ///< Returns true if the watcher has lost track of the changes to the
+       ///< video directory, and a full scan is necessary. If Reset is true,
+       ///< this is only reported once.
+  };
+
+cVideoDirectoryWatcher::cVideoDirectoryWatcher(void)
+:cThread("video directory watcher", true)
+,watchesByWd(HASHSIZE * 4)
 {
-  // The first one to be destructed deletes it:
-  delete videoDirectoryScannerThread;
-  videoDirectoryScannerThread = NULL;
+  fd = -1;
+  watching = false;
+  needsUpdate = false;
+  failed = false;
 }
 
-const char *cRecordings::UpdateFileName(void)
+cVideoDirectoryWatcher::~cVideoDirectoryWatcher()
 {
-  if (!updateFileName)
-     updateFileName = strdup(AddDirectory(cVideoDirectory::Name(), ".update"));
-  return updateFileName;
+  Cancel(3);
+  if (fd >= 0)
+     close(fd);
 }
 
-void cRecordings::TouchUpdate(void)
+bool cVideoDirectoryWatcher::Watching(void)
 {
-  bool needsUpdate = NeedsUpdate();
-  TouchFile(UpdateFileName());
-  if (!needsUpdate)
-     lastUpdate = time(NULL); // make sure we don't trigger ourselves
+  cMutexLock MutexLock(&mutex);
+  return watching;
 }
 
-bool cRecordings::NeedsUpdate(void)
+bool cVideoDirectoryWatcher::NeedsUpdate(bool Reset)
 {
-  time_t lastModified = LastModifiedTime(UpdateFileName());
-  if (lastModified > time(NULL))
-     return false; // somebody's clock isn't running correctly
-  return lastUpdate < lastModified;
+  cMutexLock MutexLock(&mutex);
+  bool Result = needsUpdate;
+  if (Reset)
+     needsUpdate = false;
+  return Result;
 }
 
-void cRecordings::Update(bool Wait)
+bool cVideoDirectoryWatcher::AddWatch(const char *Path, bool IsRecording)
 {
-  if (!videoDirectoryScannerThread)
-     videoDirectoryScannerThread = new cVideoDirectoryScannerThread(&recordings, &deletedRecordings);
-  lastUpdate = time(NULL); // doing this first to make sure we don't miss anything
-  videoDirectoryScannerThread->Start();
-  if (Wait) {
-     while (videoDirectoryScannerThread->Active())
-           cCondWait::SleepMs(100);
+  int wd = inotify_add_watch(fd, Path, IsRecording ? WATCHRECMASK : WATCHDIRMASK);
+  if (wd < 0) {
+     if (errno == ENOSPC)
+        esyslog("ERROR: can't watch video directory - too many directories (see /proc/sys/fs/inotify/max_user_watches)");
+     else if (errno == ENOENT || errno == ENOTDIR)
+        return true; // has already vanished again
+     else
+        LOG_ERROR_STR(Path);
+     failed = true;
+     return false;
+     }
+  if (cVideoDirectoryWatch *Watch = watchesByWd.Get(wd)) { // the same directory under a different name
+     Watch->path = Path;
+     Watch->isRecording = IsRecording;
      }
+  else {
+     Watch = new cVideoDirectoryWatch(wd, Path, IsRecording);
+     watches.Add(Watch);
+     watchesByWd.Add(Watch, wd);
+     }
+  return true;
 }
 
-const cRecording *cRecordings::GetById(int Id) const
+void cVideoDirectoryWatcher::DelWatches(const char *Path)
 {
-  for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
-      if (Recording->Id() == Id)
-         return Recording;
+  int l = strlen(Path);
+  for (cVideoDirectoryWatch *Watch = watches.First(); Watch; ) {
+      cVideoDirectoryWatch *w = Watch;
+      Watch = watches.Next(Watch);
+      if (strncmp(w->path, Path, l) == 0 && ((*w->path)[l] == 0 || (*w->path)[l] == '/')) {
+         inotify_rm_watch(fd, w->wd); // fails harmlessly if the directory no longer exists
+         watchesByWd.Del(w, w->wd);
+         watches.Del(w);
+         }
       }
-  return NULL;
 }
 
-const cRecording *cRecordings::GetByName(const char *FileName) const
+void cVideoDirectoryWatcher::WatchDir(const char *DirName, int LinkLevel, bool Scan)
 {
-  if (FileName) {
-     for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
-         if (strcmp(Recording->FileName(), FileName) == 0)
-            return Recording;
-         }
+  if (!AddWatch(DirName, false))
+     return;
+  cReadDir d(DirName);
+  struct dirent *e;
+  while (Running() && !failed && (e = d.Next()) != NULL) {
+        cString buffer = AddDirectory(DirName, e->d_name);
+        struct stat st;
+        if (lstat(buffer, &st) == 0) {
+           int Link = 0;
+           if (S_ISLNK(st.st_mode)) {
+              if (LinkLevel > MAX_LINK_LEVEL)
+                 continue;
+              Link = 1;
+              if (stat(buffer, &st) != 0)
+                 continue;
+              }
+           if (S_ISDIR(st.st_mode)) {
+              if (endswith(buffer, RECEXT)) {
+                 if (AddWatch(buffer, true) && Scan)
+                    RecordingAdded(buffer);
+                 }
+              else if (endswith(buffer, DELEXT)) {
+                 if (Scan)
+                    RecordingAdded(buffer);
+                 }
+              else
+                 WatchDir(buffer, LinkLevel + Link, Scan);
+              }
+           }
+        }
+}
+
+void cVideoDirectoryWatcher::Reset(void)
+{
+  for (cVideoDirectoryWatch *Watch = watches.First(); Watch; Watch = watches.Next(Watch))
+      inotify_rm_watch(fd, Watch->wd);
+  watchesByWd.Clear();
+  watches.Clear();
+  WatchDir(cVideoDirectory::Name(), 0, false);
+  cMutexLock MutexLock(&mutex);
+  needsUpdate = true;
+}
+
+void cVideoDirectoryWatcher::RecordingAdded(const char *FileName)
+{
+  if (endswith(FileName, DELEXT)) {
+     LOCK_DELETEDRECORDINGS_WRITE;
+     if (!DeletedRecordings->GetByName(FileName)) {
+        cRecording *Recording = new cRecording(FileName);
+        if (Recording->Name()) {
+           Recording->SetDeleted();
+           DeletedRecordings->Add(Recording);
+           }
+        else
+           delete Recording;
+        }
+     }
+  else {
+     LOCK_RECORDINGS_WRITE;
+     Recordings->AddByName(FileName, false);
+     }
+}
+
+void cVideoDirectoryWatcher::RecordingRemoved(const char *FileName)
+{
+  cStateKey StateKey;
+  cRecordings *Recordings = endswith(FileName, DELEXT) ? cRecordings::GetDeletedRecordingsWrite(StateKey) : cRecordings::GetRecordingsWrite(StateKey);
+  if (cRecording *Recording = Recordings->GetByName(FileName))
+     Recordings->Del(Recording);
+  StateKey.Remove();
+}
+
+void cVideoDirectoryWatcher::DirRemoved(const char *DirName)
+{
+  DelWatches(DirName);
+  int l = strlen(DirName);
+  for (int i = 0; i < 2; i++) {
+      cStateKey StateKey;
+      cRecordings *Recordings = i ? cRecordings::GetDeletedRecordingsWrite(StateKey) : cRecordings::GetRecordingsWrite(StateKey);
+      for (cRecording *Recording = Recordings->First(); Recording; ) {
+          cRecording *r = Recording;
+          Recording = Recordings->Next(Recording);
+          if (strncmp(r->FileName(), DirName, l) == 0 && r->FileName()[l] == '/')
+             Recordings->Del(r);
+          }
+      StateKey.Remove();
+      }
+}
+
+void cVideoDirectoryWatcher::HandleEvent(const struct inotify_event *Event)
+{
+  if (Event->mask & IN_Q_OVERFLOW) {
+     isyslog("video directory watcher lost track of changes - rescanning");
+     Reset();
+     return;
+     }
+  cVideoDirectoryWatch *Watch = watchesByWd.Get(Event->wd);
+  if (!Watch)
+     return; // events for watches that have been deleted in the meantime
+  if (Event->mask & IN_IGNORED) {
+     watchesByWd.Del(Watch, Watch->wd);
+     watches.Del(Watch);
+     return;
+     }
+  if (!Event->len)
+     return;
+  if (Watch->isRecording) {
+     if (!(Event->mask & IN_ISDIR)) {
+        if (strcmp(Event->name, "info") == 0 || strcmp(Event->name, "info.vdr") == 0) {
+           LOCK_RECORDINGS_WRITE;
+           Recordings->UpdateByName(Watch->path);
+           }
+        else if (strcmp(Event->name, "resume") == 0 || strcmp(Event->name, "resume.vdr") == 0) {
+           LOCK_RECORDINGS_WRITE;
+           Recordings->ResetResume(Watch->path);
+           }
+        }
+     }
+  else if (Event->mask & IN_ISDIR) {
+     cString FileName = AddDirectory(Watch->path, Event->name);
+     bool IsRecording = endswith(FileName, RECEXT) || endswith(FileName, DELEXT);
+     if (Event->mask & (IN_CREATE | IN_MOVED_TO)) {
+        if (IsRecording) {
+           if (!endswith(FileName, RECEXT) || AddWatch(FileName, true))
+              RecordingAdded(FileName);
+           }
+        else
+           WatchDir(FileName, 0, true);
+        }
+     else if (Event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (IsRecording) {
+           DelWatches(FileName);
+           RecordingRemoved(FileName);
+           }
+        else
+           DirRemoved(FileName);
+        }
+     }
+}
+
+void cVideoDirectoryWatcher::Action(void)
+{
+  fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0) {
+     LOG_ERROR;
+     return;
+     }
+  WatchDir(cVideoDirectory::Name(), 0, false);
+  if (!failed) {
+     dsyslog("watching %d directories in %s", watches.Count(), cVideoDirectory::Name());
+     cMutexLock MutexLock(&mutex);
+     watching = true;
+     }
+  char Buffer[16 * 1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  cPoller Poller(fd);
+  while (Running() && !failed) {
+        if (Poller.Poll(1000)) {
+           int r = safe_read(fd, Buffer, sizeof(Buffer));
+           if (r < 0) {
+              LOG_ERROR;
+              break;
+              }
+           for (char *p = Buffer; p < Buffer + r && !failed; ) {
+               const struct inotify_event *Event = (const struct inotify_event *)p;
+               HandleEvent(Event);
+               p += sizeof(struct inotify_event) + Event->len;
+               }
+           }
+        }
+  // From here on the '.update' file is used again to detect changes:
+  watchesByWd.Clear();
+  watches.Clear();
+  close(fd);
+  fd = -1;
+  cMutexLock MutexLock(&mutex);
+  if (watching)
+     needsUpdate = true;
+  watching = false;
+}
+
+// --- cRecordingsSortIndex -------------------------------------------------
+
+#define MAXSORTINDEXCHANGES 8 // rebuild the index if more than 1/8 of its entries need to be repositioned
+
+class cRecordingsSortIndex {
+private:
+  eRecordingsSortMode sortMode;
+  cVector<const cRecording *> recordings;
+  cVector<int> versions; // the sortNameVersion of each recording when it was sorted in
+  cVector<const cRecording *> pending; // recordings that still need to be sorted in
+  bool valid;
+  static int CompareByName(const void *a, const void *b);
+  static int CompareByTime(const void *a, const void *b);
+  int Compare(const cRecording *Recording1, const cRecording *Recording2) const;
+  void Insert(const cRecording *Recording);
+  void Build(const cRecordings *Recordings);
+public:
+  cRecordingsSortIndex(eRecordingsSortMode SortMode);
+  void Invalidate(void) { valid = false; }
+  void Add(const cRecording *Recording);
+  void Del(const cRecording *Recording);
+  const cVector<const cRecording *> &Get(const cRecordings *Recordings);
+  };
+
+cRecordingsSortIndex::cRecordingsSortIndex(eRecordingsSortMode SortMode)
+{
+  sortMode = SortMode;
+  valid = false;
+}
+
+int cRecordingsSortIndex::CompareByName(const void *a, const void *b)
+{
+  const char *s1 = (*(const cRecording **)a)->SortName(rsmName);
+  const char *s2 = (*(const cRecording **)b)->SortName(rsmName);
+  return (Setup.RecSortingDirection == rsdAscending) ? strcmp(s1, s2) : strcmp(s2, s1);
+}
+
+int cRecordingsSortIndex::CompareByTime(const void *a, const void *b)
+{
+  const char *s1 = (*(const cRecording **)a)->SortName(rsmTime);
+  const char *s2 = (*(const cRecording **)b)->SortName(rsmTime);
+  return (Setup.RecSortingDirection == rsdAscending) ? strcmp(s1, s2) : strcmp(s2, s1);
+}
+
+int cRecordingsSortIndex::Compare(const cRecording *Recording1, const cRecording *Recording2) const
+{
+  return sortMode == rsmName ? CompareByName(&Recording1, &Recording2) : CompareByTime(&Recording1, &Recording2);
+}
+
+void cRecordingsSortIndex::Insert(const cRecording *Recording)
+{
+  // Binary search for the position after any equal entries:
+  int Low = 0;
+  int High = recordings.Size();
+  while (Low < High) {
+        int Middle = (Low + High) / 2;
+        if (Compare(recordings[Middle], Recording) <= 0)
+           Low = Middle + 1;
+        else
+           High = Middle;
+        }
+  recordings.Insert(Recording, Low);
+  versions.Insert(Recording->sortNameVersion, Low);
+}
+
+void cRecordingsSortIndex::Build(const cRecordings *Recordings)
+{
+  recordings.Clear();
+  versions.Clear();
+  pending.Clear();
+  for (const cRecording *Recording = Recordings->First(); Recording; Recording = Recordings->Next(Recording))
+      recordings.Append(Recording);
+  recordings.Sort(sortMode == rsmName ? CompareByName : CompareByTime);
+  for (int i = 0; i < recordings.Size(); i++)
+      versions.Append(recordings[i]->sortNameVersion);
+  valid = true;
+}
+
+void cRecordingsSortIndex::Add(const cRecording *Recording)
+{
+  if (valid)
+     pending.Append(Recording);
+}
+
+void cRecordingsSortIndex::Del(const cRecording *Recording)
+{
+  if (valid) {
+     int i = recordings.IndexOf(Recording);
+     if (i >= 0) {
+        recordings.Remove(i);
+        versions.Remove(i);
+        }
+     else
+        pending.RemoveElement(Recording);
+     }
+}
+
+const cVector<const cRecording *> &cRecordingsSortIndex::Get(const cRecordings *Recordings)
+{
+  if (valid) {
+     // Take out any recordings that have been renamed since they were sorted in:
+     int n = 0;
+     for (int i = 0; i < recordings.Size(); i++) {
+         if (recordings[i]->sortNameVersion != versions[i])
+            pending.Append(recordings[i]);
+         else {
+            recordings[n] = recordings[i];
+            versions[n] = versions[i];
+            n++;
+            }
+         }
+     while (recordings.Size() > n) {
+           recordings.Remove(recordings.Size() - 1);
+           versions.Remove(versions.Size() - 1);
+           }
+     // Sort in the pending ones, unless it's cheaper to sort everything anew:
+     if (pending.Size() > recordings.Size() / MAXSORTINDEXCHANGES)
+        valid = false;
+     else {
+        for (int i = 0; i < pending.Size(); i++)
+            Insert(pending[i]);
+        pending.Clear();
+        }
+     }
+  if (!valid)
+     Build(Recordings);
+  return recordings;
+}
+
+// --- cRecordings -----------------------------------------------------------
+
+cRecordings cRecordings::recordings;
+cRecordings cRecordings::deletedRecordings(true);
+int cRecordings::lastRecordingId = 0;
+char *cRecordings::updateFileName = NULL;
+char *cRecordings::cacheFileName = NULL;
+cVideoDirectoryScannerThread *cRecordings::videoDirectoryScannerThread = NULL;
+cVideoDirectoryWatcher *cRecordings::videoDirectoryWatcher = NULL;
+time_t cRecordings::lastUpdate = 0;
+
+cRecordings::cRecordings(bool Deleted)
+:cList<cRecording>(Deleted ? "4 DelRecs" : "3 Recordings")
+,recordingsByName(HASHSIZE * 8)
+,recordingsById(HASHSIZE * 8)
+{
+  sortIndex[rsmName] = sortIndex[rsmTime] = NULL;
+  nameIndexVersion = cRecording::FileNameChanges();
+  totalFileSizeMB = 0;
+  mbPerMinute = -1;
+  totalsVersion = -1;
+}
+
+cRecordings::~cRecordings()
+{
+  delete sortIndex[rsmName];
+  delete sortIndex[rsmTime];
+  // The first one to be destructed deletes them:
+  delete videoDirectoryWatcher;
+  videoDirectoryWatcher = NULL;
+  delete videoDirectoryScannerThread;
+  videoDirectoryScannerThread = NULL;
+}
+
+const char *cRecordings::UpdateFileName(void)
+{
+  if (!updateFileName)
+     updateFileName = strdup(AddDirectory(cVideoDirectory::Name(), ".update"));
+  return updateFileName;
+}
+
+void cRecordings::SetCacheFileName(const char *FileName)
+{
+  free(cacheFileName);
+  cacheFileName = FileName ? strdup(FileName) : NULL;
+}
+
+void cRecordings::TouchUpdate(void)
+{
+  // The watcher's flag isn't reset here, so that a full scan it needs isn't lost
+  // if lastUpdate is set below:
+  bool needsUpdate = videoDirectoryWatcher && videoDirectoryWatcher->NeedsUpdate(false);
+  if (!needsUpdate) {
+     time_t lastModified = LastModifiedTime(UpdateFileName());
+     needsUpdate = lastUpdate < lastModified && lastModified <= time(NULL);
+     }
+  TouchFile(UpdateFileName());
+  if (!needsUpdate)
+     lastUpdate = time(NULL); // make sure we don't trigger ourselves
+}
+
+bool cRecordings::NeedsUpdate(void)
+{
+  if (videoDirectoryWatcher && videoDirectoryWatcher->NeedsUpdate())
+     return true;
+  // Even if the watcher is active, the ".update" file must be checked, because
+  // it may have been touched by other programs (or another instance of VDR on a
+  // different machine), whose changes don't necessarily cause inotify events:
+  time_t lastModified = LastModifiedTime(UpdateFileName());
+  if (lastModified > time(NULL))
+     return false; // somebody's clock isn't running correctly
+  return lastUpdate < lastModified;
+}
+
+void cRecordings::Update(bool Wait)
+{
+  if (!videoDirectoryWatcher) {
+     videoDirectoryWatcher = new cVideoDirectoryWatcher;
+     videoDirectoryWatcher->Start();
+     }
+  if (!videoDirectoryScannerThread)
+     videoDirectoryScannerThread = new cVideoDirectoryScannerThread(&recordings, &deletedRecordings);
+  lastUpdate = time(NULL); // doing this first to make sure we don't miss anything
+  videoDirectoryScannerThread->Start();
+  if (Wait) {
+     while (videoDirectoryScannerThread->Active())
+           cCondWait::SleepMs(100);
+     }
+}
+
+void cRecordings::UpdateNameIndex(void) const
+{
+  // The caller must hold indexMutex.
+  int FileNameChanges = cRecording::FileNameChanges();
+  if (nameIndexVersion != FileNameChanges) {
+     // Some recording's file name has changed, so the index is rebuilt:
+     recordingsByName.Clear();
+     for (const cRecording *Recording = First(); Recording; Recording = Next(Recording))
+         recordingsByName.Add(const_cast<cRecording *>(Recording), HashString(Recording->FileName()));
+     nameIndexVersion = FileNameChanges;
+     }
+}
+
+const cRecording *cRecordings::GetById(int Id) const
+{
+  return recordingsById.Get(Id);
+}
+
+const cRecording *cRecordings::GetByName(const char *FileName) const
+{
+  if (FileName) {
+     cMutexLock MutexLock(&indexMutex);
+     UpdateNameIndex();
+     if (cList<cHashObject> *List = recordingsByName.GetList(HashString(FileName))) {
+        for (cHashObject *hob = List->First(); hob; hob = List->Next(hob)) {
+            const cRecording *Recording = (const cRecording *)hob->Object();
+            if (strcmp(Recording->FileName(), FileName) == 0)
+               return Recording;
+            }
+        }
      }
   return NULL;
 }
 
+const cVector<const cRecording *> &cRecordings::Sorted(void) const
+{
+  cMutexLock MutexLock(&indexMutex);
+  if (!sortIndex[RecordingsSortMode])
+     sortIndex[RecordingsSortMode] = new cRecordingsSortIndex(RecordingsSortMode);
+  return sortIndex[RecordingsSortMode]->Get(this);
+}
+
+void cRecordings::Clear(void)
+{
+  cMutexLock MutexLock(&indexMutex);
+  for (int i = rsmName; i <= rsmTime; i++) {
+      if (sortIndex[i])
+         sortIndex[i]->Invalidate();
+      }
+  recordingsByName.Clear();
+  recordingsById.Clear();
+  cRecording::SizeChanged();
+  cList<cRecording>::Clear();
+}
+
 void cRecordings::Add(cRecording *Recording)
 {
   Recording->SetId(++lastRecordingId);
+  cMutexLock MutexLock(&indexMutex);
+  UpdateNameIndex(); // a rebuild of the index must not already contain the new recording
   cList<cRecording>::Add(Recording);
+  for (int i = rsmName; i <= rsmTime; i++) {
+      if (sortIndex[i])
+         sortIndex[i]->Add(Recording);
+      }
+  recordingsByName.Add(Recording, HashString(Recording->FileName()));
+  recordingsById.Add(Recording, Recording->Id());
+  cRecording::SizeChanged();
+}
+
+void cRecordings::Del(cRecording *Recording, bool DeleteObject)
+{
+  cMutexLock MutexLock(&indexMutex);
+  for (int i = rsmName; i <= rsmTime; i++) {
+      if (sortIndex[i])
+         sortIndex[i]->Del(Recording);
+      }
+  UpdateNameIndex();
+  recordingsByName.Del(Recording, HashString(Recording->FileName()));
+  recordingsById.Del(Recording, Recording->Id());
+  cRecording::SizeChanged();
+  cList<cRecording>::Del(Recording, DeleteObject);
 }
 
 void cRecordings::AddByName(const char *FileName, bool TriggerUpdate)
@@ -1597,36 +2451,67 @@ void cRecordings::UpdateByName(const char *FileName)
      Recording->ReadInfo();
 }
 
-int cRecordings::TotalFileSizeMB(void) const
+void cRecordings::SetRecordingSize(const char *FileName, int NumFrames, int FileSizeMB)
 {
-  int size = 0;
-  for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
-      int FileSizeMB = Recording->FileSizeMB();
-      if (FileSizeMB > 0 && Recording->IsOnVideoDirectoryFileSystem())
-         size += FileSizeMB;
-      }
-  return size;
+  if (cRecording *Recording = GetByName(FileName)) {
+     if (Recording->numFrames != NumFrames || Recording->fileSizeMB != FileSizeMB) {
+        Recording->numFrames = NumFrames;
+        Recording->fileSizeMB = FileSizeMB;
+        cRecording::SizeChanged();
+        }
+     }
 }
 
-double cRecordings::MBperMinute(void) const
+void cRecordings::UpdateRecordingSize(const char *FileName, int NumFrames, int FileSizeMB)
 {
-  int size = 0;
-  int length = 0;
-  for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
-      if (Recording->IsOnVideoDirectoryFileSystem()) {
+  cStateKey StateKey;
+  if (cRecordings *Recordings = cRecordings::GetRecordingsWrite(StateKey, 10)) {
+     Recordings->SetRecordingSize(FileName, NumFrames, FileSizeMB);
+     StateKey.Remove(false); // the size doesn't count as a real modification
+     }
+}
+
+void cRecordings::UpdateTotals(void) const
+{
+  // The caller must hold indexMutex.
+  if (totalsVersion != cRecording::SizeChanges()) {
+     bool Complete = true;
+     int Size = 0;
+     int MbpmSize = 0;
+     int MbpmLength = 0;
+     for (const cRecording *Recording = First(); Recording; Recording = Next(Recording)) {
          int FileSizeMB = Recording->FileSizeMB();
-         if (FileSizeMB > 0) {
-            int LengthInSeconds = Recording->LengthInSeconds();
+         int LengthInSeconds = Recording->LengthInSeconds();
+         if (Recording->fileSizeMB < 0 || Recording->numFrames < 0)
+            Complete = false; // ongoing recording, so we need to check again next time
+         if (FileSizeMB > 0 && Recording->IsOnVideoDirectoryFileSystem()) {
+            Size += FileSizeMB;
             if (LengthInSeconds > 0) {
                if (LengthInSeconds / FileSizeMB < LIMIT_SECS_PER_MB_RADIO) { // don't count radio recordings
-                  size += FileSizeMB;
-                  length += LengthInSeconds;
+                  MbpmSize += FileSizeMB;
+                  MbpmLength += LengthInSeconds;
                   }
                }
             }
          }
-      }
-  return (size && length) ? double(size) * 60 / length : -1;
+     totalFileSizeMB = Size;
+     mbPerMinute = (MbpmSize && MbpmLength) ? double(MbpmSize) * 60 / MbpmLength : -1;
+     totalsVersion = Complete ? cRecording::SizeChanges() : -1;
+     }
+}
+
+int cRecordings::TotalFileSizeMB(void) const
+{
+  cMutexLock MutexLock(&indexMutex);
+  UpdateTotals();
+  return totalFileSizeMB;
+}
+
+double cRecordings::MBperMinute(void) const
+{
+  cMutexLock MutexLock(&indexMutex);
+  UpdateTotals();
+  return mbPerMinute;
 }
 
 int cRecordings::PathIsInUse(const char *Path) const
@@ -1679,6 +2564,11 @@ void cRecordings::ResetResume(const char *ResumeFileName)
 
 void cRecordings::ClearSortNames(void)
 {
+  cMutexLock MutexLock(&indexMutex);
+  for (int i = rsmName; i <= rsmTime; i++) {
+      if (sortIndex[i])
+         sortIndex[i]->Invalidate();
+      }
   for (cRecording *Recording = First(); Recording; Recording = Next(Recording))
       Recording->ClearSortName();
 }
@@ -1846,6 +2736,236 @@ void cDirCopier::Action(void)
      esyslog("ERROR: can't access '%s'", *dirNameDst);
 }
 
+// --- cRecordingsReclaimer --------------------------------------------------
+
+class cRecordingsReclaimerEntry : public cListObject {
+private:
+  cString fileName;
+  int fileSizeMB;
+public:
+  cRecordingsReclaimerEntry(const char *FileName, int FileSizeMB) { fileName = FileName; fileSizeMB = max(FileSizeMB, 0); }
+  const char *FileName(void) const { return fileName; }
+  int FileSizeMB(void) const { return fileSizeMB; }
+  void SetFileSizeMB(int FileSizeMB) { fileSizeMB = FileSizeMB; }
+  };
+
+class cRecordingsReclaimer : public cThread {
+private:
+  cMutex mutex;
+  cCondVar entryAdded;
+  cList<cRecordingsReclaimerEntry> entries;
+  bool suspensionLogged;
+  bool Throttled(void);
+  bool TruncateFile(const char *FileName, cRecordingsReclaimerEntry *Entry);
+  bool TruncateFiles(cRecordingsReclaimerEntry *Entry);
+  void UpdateFileSize(cRecordingsReclaimerEntry *Entry);
+  void RemoveRecording(const char *FileName);
+protected:
+  virtual void Action(void);
+public:
+  cRecordingsReclaimer(void);
+  virtual ~cRecordingsReclaimer();
+  bool Add(const char *FileName, int FileSizeMB);
+  bool Contains(const char *FileName);
+  bool Reclaiming(int *RemainingMB);
+  };
+
+cRecordingsReclaimer::cRecordingsReclaimer(void)
+:cThread("remove deleted recordings", true)
+{
+  suspensionLogged = false;
+}
+
+cRecordingsReclaimer::~cRecordingsReclaimer()
+{
+  Cancel(3);
+}
+
+bool cRecordingsReclaimer::Add(const char *FileName, int FileSizeMB)
+{
+  // let's do a final safety check here:
+  if (!endswith(FileName, DELEXT)) {
+     esyslog("attempt to remove recording %s", FileName);
+     return false;
+     }
+  cMutexLock MutexLock(&mutex);
+  if (!Contains(FileName)) {
+     entries.Add(new cRecordingsReclaimerEntry(FileName, FileSizeMB));
+     entryAdded.Broadcast();
+     }
+  Start(); // the thread keeps running once it has been started
+  return true;
+}
+
+bool cRecordingsReclaimer::Contains(const char *FileName)
+{
+  cMutexLock MutexLock(&mutex);
+  for (cRecordingsReclaimerEntry *e = entries.First(); e; e = entries.Next(e)) {
+      if (strcmp(e->FileName(), FileName) == 0)
+         return true;
+      }
+  return false;
+}
+
+bool cRecordingsReclaimer::Reclaiming(int *RemainingMB)
+{
+  cMutexLock MutexLock(&mutex);
+  if (RemainingMB) {
+     *RemainingMB = 0;
+     for (cRecordingsReclaimerEntry *e = entries.First(); e; e = entries.Next(e))
+         *RemainingMB += e->FileSizeMB();
+     }
+  return entries.Count() > 0;
+}
+
+bool cRecordingsReclaimer::Throttled(void)
+{
+  if (cIoThrottle::Engaged()) {
+     if (!suspensionLogged) {
+        dsyslog("suspending removal of deleted recordings");
+        suspensionLogged = true;
+        }
+     return true;
+     }
+  else if (suspensionLogged) {
+     dsyslog("resuming removal of deleted recordings");
+     suspensionLogged = false;
+     }
+  return false;
+}
+
+bool cRecordingsReclaimer::TruncateFile(const char *FileName, cRecordingsReclaimerEntry *Entry)
+{
+  int f = open(FileName, O_WRONLY);
+  if (f < 0) {
+     LOG_ERROR_STR(FileName);
+     return true; // the final removal will take care of it
+     }
+  struct stat st;
+  if (fstat(f, &st) == 0) {
+     off_t Size = st.st_size;
+     while (Size > 0) {
+           // Let the recorders have the disk bandwidth if they need it:
+           while (Throttled()) {
+                 if (!Running()) {
+                    close(f);
+                    return false;
+                    }
+                 cCondWait::SleepMs(100);
+                 }
+           if (!Running()) {
+              close(f);
+              return false;
+              }
+           off_t Step = min(Size, off_t(MEGABYTE(RECLAIMSTEPMB)));
+           if (ftruncate(f, Size - Step) < 0) {
+              LOG_ERROR_STR(FileName);
+              break;
+              }
+           Size -= Step;
+           mutex.Lock();
+           Entry->SetFileSizeMB(max(Entry->FileSizeMB() - int(Step / MEGABYTE(1)), 0));
+           mutex.Unlock();
+           cCondWait::SleepMs(RECLAIMSTEPDELAY);
+           }
+     }
+  else
+     LOG_ERROR_STR(FileName);
+  close(f);
+  return true;
+}
+
+bool cRecordingsReclaimer::TruncateFiles(cRecordingsReclaimerEntry *Entry)
+{
+  cReadDir d(Entry->FileName());
+  if (d.Ok()) {
+     struct dirent *e;
+     while ((e = d.Next()) != NULL) {
+           cString FileName = AddDirectory(Entry->FileName(), e->d_name);
+           struct stat st;
+           // The index file is left alone, because it may still be memory mapped by a
+           // cIndexFile (see cIndexFile::MapIndex()), and it's small anyway:
+           if (lstat(FileName, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > MEGABYTE(RECLAIMSTEPMB) && !startswith(e->d_name, "index")) {
+              if (!TruncateFile(FileName, Entry))
+                 return false;
+              int SizeMB = DirSizeMB(Entry->FileName());
+              if (SizeMB >= 0) {
+                 cMutexLock MutexLock(&mutex);
+                 Entry->SetFileSizeMB(SizeMB);
+                 }
+              UpdateFileSize(Entry);
+              }
+           }
+     }
+  return true;
+}
+
+void cRecordingsReclaimer::UpdateFileSize(cRecordingsReclaimerEntry *Entry)
+{
+  // Make the total size of the deleted recordings reflect the disk space
+  // that has actually been freed so far (not waiting if the list is locked):
+  cStateKey StateKey;
+  if (cRecordings *DeletedRecordings = cRecordings::GetDeletedRecordingsWrite(StateKey, 10)) {
+     if (cRecording *Recording = DeletedRecordings->GetByName(Entry->FileName())) {
+        cMutexLock MutexLock(&mutex);
+        if (Recording->fileSizeMB != Entry->FileSizeMB()) {
+           Recording->fileSizeMB = Entry->FileSizeMB();
+           cRecording::SizeChanged();
+           }
+        }
+     StateKey.Remove(false); // the size doesn't count as a real modification
+     }
+}
+
+void cRecordingsReclaimer::RemoveRecording(const char *FileName)
+{
+  LOCK_DELETEDRECORDINGS_WRITE;
+  if (cRecording *Recording = DeletedRecordings->GetByName(FileName)) {
+     Recording->Remove();
+     DeletedRecordings->Del(Recording);
+     }
+  else
+     isyslog("deleted recording '%s' vanished", FileName);
+}
+
+void cRecordingsReclaimer::Action(void)
+{
+  bool Removed = false;
+  while (Running()) {
+        cRecordingsReclaimerEntry *Entry;
+        {
+          cMutexLock MutexLock(&mutex);
+          if (!(Entry = entries.First()) && !Removed) {
+             entryAdded.TimedWait(mutex, RECLAIMWAIT);
+             continue;
+             }
+        }
+        if (!Entry) {
+           // All deleted recordings in the list have been removed:
+           Removed = false;
+           cRecordings::TouchUpdate();
+           const char *IgnoreFiles[] = { SORTMODEFILE, TIMERRECFILE, NULL };
+           cVideoDirectory::RemoveEmptyVideoDirectories(IgnoreFiles);
+           continue;
+           }
+        // Make sure only one instance of VDR does this:
+        cLockFile LockFile(cVideoDirectory::Name());
+        if (!LockFile.Lock()) {
+           cMutexLock MutexLock(&mutex);
+           entryAdded.TimedWait(mutex, RECLAIMLOCKWAIT);
+           continue;
+           }
+        // Only this thread deletes entries, so it's safe to use Entry without the lock:
+        dsyslog("freeing disk space of deleted recording %s", Entry->FileName());
+        if (!TruncateFiles(Entry))
+           break;
+        RemoveRecording(Entry->FileName());
+        Removed = true;
+        cMutexLock MutexLock(&mutex);
+        entries.Del(Entry);
+        }
+}
+
 // --- cRecordingsHandlerEntry -----------------------------------------------
 
 class cRecordingsHandlerEntry : public cListObject {
@@ -1906,6 +3026,8 @@ bool cRecordingsHandlerEntry::Active(cRecordings *Recordings)
      if (cutter->Active())
         return true;
      error = cutter->Error();
+     if (!error)
+        Recordings->SetRecordingSize(FileNameDst(), cutter->NumFrames(), cutter->FileSizeMB());
      delete cutter;
      cutter = NULL;
      }
@@ -1979,6 +3101,7 @@ cRecordingsHandler RecordingsHandler;
 cRecordingsHandler::cRecordingsHandler(void)
 :cThread("recordings handler")
 {
+  reclaimer = new cRecordingsReclaimer;
   finished = true;
   error = false;
 }
@@ -1986,6 +3109,7 @@ cRecordingsHandler::cRecordingsHandler(void)
 cRecordingsHandler::~cRecordingsHandler()
 {
   Cancel(3);
+  delete reclaimer;
 }
 
 void cRecordingsHandler::Action(void)
@@ -2076,9 +3200,23 @@ int cRecordingsHandler::GetUsage(const char *FileName)
   cMutexLock MutexLock(&mutex);
   if (cRecordingsHandlerEntry *r = Get(FileName))
      return r->Usage(FileName);
+  if (FileName && *FileName && reclaimer->Contains(FileName))
+     return ruRemove;
   return ruNone;
 }
 
+bool cRecordingsHandler::Remove(const char *FileName, int FileSizeMB)
+{
+  if (FileName && *FileName)
+     return reclaimer->Add(FileName, FileSizeMB);
+  return false;
+}
+
+bool cRecordingsHandler::Reclaiming(int *RemainingMB)
+{
+  return reclaimer->Reclaiming(RemainingMB);
+}
+
 bool cRecordingsHandler::Finished(bool &Error)
 {
   cMutexLock MutexLock(&mutex);
@@ -2326,14 +3464,228 @@ void cRecordingUserCommand::InvokeCommand(const char *State, const char *Recordi
   }
 }
 
+// --- cIndexChunkGenerator --------------------------------------------------
+
+#define IFG_BUFFER_SIZE KILOBYTE(100)
+#ifndef IFG_CHUNK_SIZE
+#define IFG_CHUNK_SIZE  MEGABYTE(256) // index files are generated in parallel from chunks of this size
+#endif
+#ifndef IFG_MIN_CPUS
+#define IFG_MIN_CPUS    2 // index files are only generated in parallel if there are at least this many CPUs
+#endif
+#define IFG_MAX_WORKERS 4 // the maximum number of chunks that are processed at the same time
+#define IFG_CHUNK_WAIT  10 // ms between checks whether a chunk has been processed
+
+// IFG_CHUNK_SIZE and IFG_MIN_CPUS may be overwritten, and IFG_FAIL_CHUNK(FileNumber, Begin)
+// may be defined to make the matching chunks fail, by tests/indexgen.c.
+
+static double ThreadCpuSeconds(void)
+{
+  // Returns the user CPU time the calling thread has used so far:
+  struct rusage Usage;
+  if (getrusage(RUSAGE_THREAD, &Usage) == 0)
+     return Usage.ru_utime.tv_sec + Usage.ru_utime.tv_usec / 1e6;
+  return 0;
+}
+
+class cIndexChunkGenerator : public cListObject, public cThread {
+private:
+  cString recordingName;
+  int fileNumber;
+  off_t begin;
+  off_t end;
+  bool ok;
+  off_t bytes;
+  double cpuSeconds;
+  cFrameDetector frameDetector;
+  cVector<off_t> frameOffsets;
+  cVector<bool> independentFrames;
+protected:
+  virtual void Action(void);
+public:
+  cIndexChunkGenerator(const char *RecordingName, int FileNumber, off_t Begin, off_t End);
+       ///< Sets up a generator for the index entries of the frames in the given file
+       ///< of the recording, starting at offset Begin (which must be the offset of a
+       ///< PAT packet, or 0) up to End. If End is -1, the rest of the file is used.
+       ///< The frame detector is synced on the beginning of the recording, just like
+       ///< cIndexFileGenerator does, so that the resulting index entries are the same.
+  ~cIndexChunkGenerator();
+  bool Ok(void) const { return ok; }
+       ///< Returns true if the chunk has been processed completely.
+  int FileNumber(void) const { return fileNumber; }
+  off_t Begin(void) const { return begin; }
+  int Frames(void) const { return frameOffsets.Size(); }
+  off_t FrameOffset(int Index) const { return frameOffsets[Index]; }
+  bool IndependentFrame(int Index) const { return independentFrames[Index]; }
+  off_t Bytes(void) const { return bytes; }
+  double CpuSeconds(void) const { return cpuSeconds; }
+       ///< Returns the user CPU time this generator's thread has used.
+  double FramesPerSecond(void) { return frameDetector.FramesPerSecond(); }
+  };
+
+cIndexChunkGenerator::cIndexChunkGenerator(const char *RecordingName, int FileNumber, off_t Begin, off_t End)
+:cThread("index chunk generator")
+,recordingName(RecordingName)
+{
+  fileNumber = FileNumber;
+  begin = Begin;
+  end = End;
+  ok = false;
+  bytes = 0;
+  cpuSeconds = 0;
+}
+
+cIndexChunkGenerator::~cIndexChunkGenerator()
+{
+  Cancel(3);
+}
+
+void cIndexChunkGenerator::Action(void)
+{
+#ifdef IFG_FAIL_CHUNK
+  if (IFG_FAIL_CHUNK(fileNumber, begin))
+     return;
+#endif
+  cFileName FileName(recordingName, false);
+  cUnbufferedFile *ReplayFile = FileName.Open();
+  cRingBufferLinear Buffer(IFG_BUFFER_SIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE);
+  cPatPmtParser PatPmtParser;
+  int BufferChunks = KILOBYTE(1); // no need to read a lot at the beginning when parsing PAT/PMT
+  off_t FileSize = 0;
+  off_t ReadOffset = 0;
+  off_t FrameOffset = -1;
+  bool Stuffed = false;
+  while (Running()) {
+        // Process data:
+        int Length;
+        uchar *Data = Buffer.Get(Length);
+        if (Data) {
+           if (frameDetector.Synced()) {
+              // Step 3 - generate the index entries of this chunk:
+              if (TsPid(Data) == PATPID)
+                 FrameOffset = FileSize; // the PAT/PMT is at the beginning of an I-frame
+              int Processed = frameDetector.Analyze(Data, Length);
+              if (Processed > 0) {
+                 if (frameDetector.NewFrame()) {
+                    frameOffsets.Append(FrameOffset >= 0 ? FrameOffset : FileSize);
+                    independentFrames.Append(frameDetector.IndependentFrame());
+                    FrameOffset = -1;
+                    }
+                 FileSize += Processed;
+                 bytes += Processed;
+                 Buffer.Del(Processed);
+                 }
+              }
+           else if (PatPmtParser.Completed()) {
+              // Step 2 - sync FrameDetector:
+              int Processed = frameDetector.Analyze(Data, Length);
+              if (Processed > 0) {
+                 if (frameDetector.Synced()) {
+                    // Synced FrameDetector, so rewind to the beginning of this chunk:
+                    ReplayFile = FileName.SetOffset(fileNumber, begin);
+                    FileSize = ReadOffset = begin;
+                    Buffer.Clear();
+                    Stuffed = false;
+                    }
+                 else
+                    Buffer.Del(Processed);
+                 }
+              }
+           else {
+              // Step 1 - parse PAT/PMT:
+              uchar *p = Data;
+              while (Length >= TS_SIZE) {
+                    int Pid = TsPid(p);
+                    if (Pid == PATPID)
+                       PatPmtParser.ParsePat(p, TS_SIZE);
+                    else if (PatPmtParser.IsPmtPid(Pid))
+                       PatPmtParser.ParsePmt(p, TS_SIZE);
+                    Length -= TS_SIZE;
+                    p += TS_SIZE;
+                    if (PatPmtParser.Completed()) {
+                       // Found pid, so rewind to sync FrameDetector:
+                       frameDetector.SetPid(PatPmtParser.Vpid() ? PatPmtParser.Vpid() : PatPmtParser.Apid(0), PatPmtParser.Vpid() ? PatPmtParser.Vtype() : PatPmtParser.Atype(0));
+                       BufferChunks = IFG_BUFFER_SIZE;
+                       ReplayFile = FileName.SetOffset(1);
+                       FileSize = ReadOffset = 0;
+                       Buffer.Clear();
+                       break;
+                       }
+                    }
+              if (!PatPmtParser.Completed())
+                 Buffer.Del(p - Data);
+              }
+           }
+        // Read data:
+        else if (ReplayFile) {
+           int Max = BufferChunks;
+           if (frameDetector.Synced() && end >= 0)
+              Max = int(min(off_t(Max), end - ReadOffset)); // don't read beyond the end of this chunk
+           int Result = Max > 0 ? Buffer.Read(ReplayFile, Max) : 0;
+           if (Result > 0)
+              ReadOffset += Result;
+           else if (Result == 0) { // end of chunk or EOF
+              if (Buffer.Available() > 0 && !Stuffed) {
+                 // Flush out the rest of the data (see cIndexFileGenerator::Action()):
+                 uchar StuffingPacket[TS_SIZE] = { TS_SYNC_BYTE, 0xFF };
+                 for (int i = 0; i <= MIN_TS_PACKETS_FOR_FRAME_DETECTOR; i++)
+                     Buffer.Put(StuffingPacket, sizeof(StuffingPacket));
+                 Stuffed = true;
+                 }
+              else if (frameDetector.Synced()) {
+                 ok = true;
+                 break;
+                 }
+              else {
+                 ReplayFile = FileName.NextFile();
+                 FileSize = ReadOffset = 0;
+                 Buffer.Clear();
+                 Stuffed = false;
+                 }
+              }
+           else if (errno != EAGAIN) {
+              LOG_ERROR_STR(FileName.Name());
+              break;
+              }
+           }
+        else
+           break; // the frame detector couldn't be synced
+        }
+  cpuSeconds = ThreadCpuSeconds();
+}
+
+static off_t FindPat(cUnbufferedFile *File, off_t Offset, off_t Limit)
+{
+  // Returns the offset of the first TS packet at or after Offset and before Limit
+  // that starts a PAT section, or -1 if there is no such packet (or the file
+  // isn't aligned to TS packets):
+  uchar Buffer[KILOBYTE(64) / TS_SIZE * TS_SIZE];
+  Offset = (Offset + TS_SIZE - 1) / TS_SIZE * TS_SIZE;
+  if (File->Seek(Offset, SEEK_SET) != Offset)
+     return -1;
+  while (Offset < Limit) {
+        int r = File->Read(Buffer, sizeof(Buffer));
+        for (int i = 0; i + TS_SIZE <= r && Offset < Limit; i += TS_SIZE, Offset += TS_SIZE) {
+            if (Buffer[i] != TS_SYNC_BYTE)
+               return -1;
+            if (TsPid(Buffer + i) == PATPID && TsPayloadStart(Buffer + i))
+               return Offset;
+            }
+        if (r < int(sizeof(Buffer)))
+           break;
+        }
+  return -1;
+}
+
 // --- cIndexFileGenerator ---------------------------------------------------
 
-#define IFG_BUFFER_SIZE KILOBYTE(100)
-
 class cIndexFileGenerator : public cThread {
 private:
   cString recordingName;
   bool update;
+  void LogStatistics(int Frames, off_t Bytes, double Seconds);
+  bool SplitIntoChunks(cList<cIndexChunkGenerator> &Chunks);
+  bool GenerateFromChunks(cList<cIndexChunkGenerator> &Chunks, cIndexFile &IndexFile, int &Frames, off_t &Bytes, double &FramesPerSecond, double &CpuSeconds, uint16_t &FileNumber, off_t &FileOffset);
 protected:
   virtual void Action(void);
 public:
@@ -2354,8 +3706,82 @@ cIndexFileGenerator::~cIndexFileGenerator()
   Cancel(3);
 }
 
+void cIndexFileGenerator::LogStatistics(int Frames, off_t Bytes, double Seconds)
+{
+  // Since the index file generator runs the complete recording through the frame
+  // detector, these figures can be used to compare the frame detector's performance
+  // between different versions, for instance by running "vdr --genindex". Seconds
+  // is the CPU time used by the generator's own thread and any chunk generators,
+  // so the figures aren't distorted by other threads of VDR:
+  if (Seconds > 0 && Bytes > 0)
+     isyslog("index file generator: %d frames, %.1f MB in %.2f s user CPU time (%.1f MB/s, %.0f frames/s, %.0f ns per TS packet)", Frames, double(Bytes) / MEGABYTE(1), Seconds, double(Bytes) / MEGABYTE(1) / Seconds, Frames / Seconds, Seconds * 1e9 / (Bytes / TS_SIZE));
+}
+
+bool cIndexFileGenerator::SplitIntoChunks(cList<cIndexChunkGenerator> &Chunks)
+{
+  // Each file of the recording is split into chunks that begin with a PAT packet
+  // (which VDR's recorder writes before every I-frame):
+  cFileName FileName(recordingName, false);
+  for (int Number = 1; cUnbufferedFile *File = FileName.SetOffset(Number); Number++) {
+      off_t Size = FileSize(FileName.Name());
+      off_t Begin = 0;
+      for (off_t Offset = IFG_CHUNK_SIZE; Offset < Size; Offset += IFG_CHUNK_SIZE) {
+          off_t Pat = FindPat(File, Offset, min(Offset + off_t(IFG_CHUNK_SIZE), Size));
+          if (Pat > Begin) {
+             Chunks.Add(new cIndexChunkGenerator(recordingName, Number, Begin, Pat));
+             Begin = Pat;
+             }
+          }
+      Chunks.Add(new cIndexChunkGenerator(recordingName, Number, Begin, -1));
+      }
+  return Chunks.Count() > 1;
+}
+
+bool cIndexFileGenerator::GenerateFromChunks(cList<cIndexChunkGenerator> &Chunks, cIndexFile &IndexFile, int &Frames, off_t &Bytes, double &FramesPerSecond, double &CpuSeconds, uint16_t &FileNumber, off_t &FileOffset)
+{
+  // If a chunk can't be processed, FileNumber and FileOffset are set to where it
+  // begins, and false is returned (all chunks before it have been written to the
+  // index file). If writing the index file fails, FileNumber is set to 0:
+  int Workers = constrain(int(sysconf(_SC_NPROCESSORS_ONLN)), 1, IFG_MAX_WORKERS);
+  isyslog("generating index file from %d chunks with %d threads", Chunks.Count(), Workers);
+  cIndexChunkGenerator *Next = Chunks.First();
+  int Started = 0;
+  bool First = true;
+  while (cIndexChunkGenerator *Chunk = Chunks.First()) {
+        // Keep the workers busy:
+        for (; Next && Started < Workers; Next = Chunks.Next(Next), Started++)
+            Next->Start();
+        // Append the index entries of the chunks in their original order:
+        while (Chunk->Active() && Running())
+              cCondWait::SleepMs(IFG_CHUNK_WAIT);
+        CpuSeconds += Chunk->CpuSeconds();
+        if (!Running() || !Chunk->Ok()) {
+           FileNumber = Chunk->FileNumber();
+           FileOffset = Chunk->Begin();
+           return false;
+           }
+        for (int i = 0; i < Chunk->Frames(); i++) {
+            if (!IndexFile.Write(Chunk->IndependentFrame(i), Chunk->FileNumber(), Chunk->FrameOffset(i))) {
+               FileNumber = 0;
+               return false;
+               }
+            }
+        Frames += Chunk->Frames();
+        Bytes += Chunk->Bytes();
+        if (First)
+           FramesPerSecond = Chunk->FramesPerSecond();
+        First = false;
+        Chunks.Del(Chunk);
+        Started--;
+        }
+  return true;
+}
+
 void cIndexFileGenerator::Action(void)
 {
+  double CpuSeconds = -ThreadCpuSeconds();
+  int Frames = 0;
+  off_t Bytes = 0;
   bool IndexFileComplete = false;
   bool IndexFileWritten = false;
   bool Rewind = false;
@@ -2387,7 +3813,25 @@ void cIndexFileGenerator::Action(void)
      }
   Skins.QueueMessage(mtInfo, tr("Regenerating index file"));
   bool Stuffed = false;
-  while (Running()) {
+  // A new index file is generated in parallel, if the recording is large enough:
+  bool Parallel = false;
+  double FramesPerSecond = 0;
+  cList<cIndexChunkGenerator> Chunks;
+  if (!update && sysconf(_SC_NPROCESSORS_ONLN) >= IFG_MIN_CPUS && SplitIntoChunks(Chunks)) {
+     Parallel = true;
+     IndexFileComplete = GenerateFromChunks(Chunks, IndexFile, Frames, Bytes, FramesPerSecond, CpuSeconds, FileNumber, FileOffset);
+     IndexFileWritten = Frames > 0;
+     if (!IndexFileComplete && !FileNumber)
+        Skins.QueueMessage(mtError, tr("Index file regeneration failed!"));
+     else if (!IndexFileComplete && Running()) {
+        // Generate the rest of the index sequentially, starting at the chunk that failed:
+        esyslog("ERROR: can't generate index file from chunks - continuing sequentially at file %d, offset %lld", FileNumber, (long long)FileOffset);
+        Chunks.Clear();
+        Parallel = false;
+        Rewind = true;
+        }
+     }
+  while (!Parallel && Running()) {
         // Rewind input file:
         if (Rewind) {
            ReplayFile = FileName.SetOffset(FileNumber, FileOffset);
@@ -2410,8 +3854,10 @@ void cIndexFileGenerator::Action(void)
                        IndexFile.Write(FrameDetector.IndependentFrame(), FileName.Number(), FrameOffset >= 0 ? FrameOffset : FileSize);
                     FrameOffset = -1;
                     IndexFileWritten = true;
+                    Frames++;
                     }
                  FileSize += Processed;
+                 Bytes += Processed;
                  Buffer.Del(Processed);
                  }
               }
@@ -2479,12 +3925,15 @@ void cIndexFileGenerator::Action(void)
            break;
            }
         }
+  if (!Parallel)
+     FramesPerSecond = FrameDetector.FramesPerSecond();
   if (IndexFileComplete) {
      if (IndexFileWritten) {
+        LogStatistics(Frames, Bytes, CpuSeconds + ThreadCpuSeconds());
         cRecordingInfo RecordingInfo(recordingName);
         if (RecordingInfo.Read()) {
-           if (FrameDetector.FramesPerSecond() > 0 && !DoubleEqual(RecordingInfo.FramesPerSecond(), FrameDetector.FramesPerSecond())) {
-              RecordingInfo.SetFramesPerSecond(FrameDetector.FramesPerSecond());
+           if (FramesPerSecond > 0 && !DoubleEqual(RecordingInfo.FramesPerSecond(), FramesPerSecond)) {
+              RecordingInfo.SetFramesPerSecond(FramesPerSecond);
               RecordingInfo.Write();
               LOCK_RECORDINGS_WRITE;
               Recordings->UpdateByName(recordingName);
@@ -2540,8 +3989,10 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
   size = 0;
   last = -1;
   index = NULL;
+  mapped = false;
   isPesRecording = IsPesRecording;
   indexFileGenerator = NULL;
+  iFramesLast = -1;
   if (FileName) {
      fileName = IndexFileName(FileName, isPesRecording);
      if (!Record && PauseLive) {
@@ -2574,10 +4025,21 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
            last = int((buf.st_size + delta) / sizeof(tIndexTs) - 1);
            if ((!Record || Update) && last >= 0) {
               size = last + 1;
-              index = MALLOC(tIndexTs, size);
-              if (index) {
-                 f = open(fileName, O_RDONLY);
-                 if (f >= 0) {
+              f = open(fileName, O_RDONLY);
+              if (f >= 0) {
+                 if (!Record && !isPesRecording) {
+                    // A TS index file can be used as is, so there's no need to read it into memory.
+                    // The file may have changed since the stat() call above, so only what's
+                    // actually there now is used:
+                    if (fstat(f, &buf) == 0) {
+                       last = int(buf.st_size / sizeof(tIndexTs)) - 1;
+                       if (last >= 0)
+                          MapIndex(last + 1);
+                       }
+                    else
+                       LOG_ERROR_STR(*fileName);
+                    }
+                 else if ((index = MALLOC(tIndexTs, size)) != NULL) {
                     if (safe_read(f, index, size_t(buf.st_size)) != buf.st_size) {
                        esyslog("ERROR: can't read from file '%s'", *fileName);
                        free(index);
@@ -2585,17 +4047,17 @@ cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, b
                        }
                     else if (isPesRecording)
                        ConvertFromPes(index, size);
-                    if (!index || time(NULL) - buf.st_mtime >= MININDEXAGE) {
-                       close(f);
-                       f = -1;
-                       }
-                    // otherwise we don't close f here, see CatchUp()!
                     }
                  else
-                    LOG_ERROR_STR(*fileName);
+                    esyslog("ERROR: can't allocate %zd bytes for index '%s'", size * sizeof(tIndexTs), *fileName);
+                 if (!index || time(NULL) - buf.st_mtime >= MININDEXAGE) {
+                    close(f);
+                    f = -1;
+                    }
+                 // otherwise we don't close f here, see CatchUp()!
                  }
               else
-                 esyslog("ERROR: can't allocate %zd bytes for index '%s'", size * sizeof(tIndexTs), *fileName);
+                 LOG_ERROR_STR(*fileName);
               }
            }
         else
@@ -2621,7 +4083,10 @@ cIndexFile::~cIndexFile()
 {
   if (f >= 0)
      close(f);
-  free(index);
+  if (mapped)
+     munmap(index, size * sizeof(tIndexTs));
+  else
+     free(index);
   delete indexFileGenerator;
 }
 
@@ -2630,6 +4095,32 @@ cString cIndexFile::IndexFileName(const char *FileName, bool IsPesRecording)
   return cString::sprintf("%s%s", FileName, IsPesRecording ? INDEXFILESUFFIX ".vdr" : INDEXFILESUFFIX);
 }
 
+bool cIndexFile::MapIndex(int Size)
+{
+  // Accessing a page of the mapping that lies entirely beyond the end of the file
+  // would cause a SIGBUS, so the mapping only extends up to the end of the page
+  // that contains the last of the given Size entries (which must be in the file).
+  // Entries that are appended to the file later are mapped by calling MapIndex()
+  // again (see CatchUp()). VDR only ever appends to an index file (a new one is
+  // written under a new inode), so the mapped part can't vanish:
+  size_t PageSize = sysconf(_SC_PAGESIZE);
+  size_t Bytes = (Size * sizeof(tIndexTs) + PageSize - 1) / PageSize * PageSize;
+  Size = int(Bytes / sizeof(tIndexTs));
+  void *p;
+  if (mapped)
+     p = mremap(index, size * sizeof(tIndexTs), Bytes, MREMAP_MAYMOVE);
+  else
+     p = mmap(NULL, Bytes, PROT_READ, MAP_SHARED, f, 0);
+  if (p == MAP_FAILED) {
+     LOG_ERROR_STR(*fileName);
+     return false;
+     }
+  index = (tIndexTs *)p;
+  size = Size;
+  mapped = true;
+  return true;
+}
+
 void cIndexFile::ConvertFromPes(tIndexTs *IndexTs, int Count)
 {
   tIndexPes IndexPes;
@@ -2666,7 +4157,12 @@ bool cIndexFile::CatchUp(int Index)
          struct stat buf;
          if (fstat(f, &buf) == 0) {
             int newLast = int(buf.st_size / sizeof(tIndexTs) - 1);
-            if (newLast > last) {
+            if (newLast > last && mapped) {
+               if (newLast >= size && !MapIndex(newLast + 1))
+                  break;
+               last = newLast;
+               }
+            else if (newLast > last) {
                int NewSize = size;
                if (NewSize <= newLast) {
                   NewSize *= 2;
@@ -2754,40 +4250,64 @@ bool cIndexFile::Get(int Index, uint16_t *FileNumber, off_t *FileOffset, bool *I
   return false;
 }
 
+void cIndexFile::UpdateIFrames(void)
+{
+  // Only entries that are actually in memory are taken into account:
+  for (int Last = min(last, size - 1); iFramesLast < Last; ) {
+      if (index[++iFramesLast].independent)
+         iFrames.Append(iFramesLast);
+      }
+}
+
+int cIndexFile::FindIFrame(int Index)
+{
+  int Low = 0;
+  int High = iFrames.Size();
+  while (Low < High) {
+        int Middle = (Low + High) / 2;
+        if (iFrames[Middle] < Index)
+           Low = Middle + 1;
+        else
+           High = Middle;
+        }
+  return Low;
+}
+
 int cIndexFile::GetNextIFrame(int Index, bool Forward, uint16_t *FileNumber, off_t *FileOffset, int *Length)
 {
   if (CatchUp()) {
-     int d = Forward ? 1 : -1;
-     for (;;) {
-         Index += d;
-         if (Index >= 0 && Index <= last) {
-            if (index[Index].independent) {
-               uint16_t fn;
-               if (!FileNumber)
-                  FileNumber = &fn;
-               off_t fo;
-               if (!FileOffset)
-                  FileOffset = &fo;
-               *FileNumber = index[Index].number;
-               *FileOffset = index[Index].offset;
-               if (Length) {
-                  if (Index < last) {
-                     uint16_t fn = index[Index + 1].number;
-                     off_t fo = index[Index + 1].offset;
-                     if (fn == *FileNumber)
-                        *Length = int(fo - *FileOffset);
-                     else
-                        *Length = -1; // this means "everything up to EOF" (the buffer's Read function will act accordingly)
-                     }
-                  else
-                     *Length = -1;
-                  }
-               return Index;
-               }
-            }
-         else
-            break;
-         }
+     cMutexLock MutexLock(&mutex);
+     UpdateIFrames();
+     Index += Forward ? 1 : -1;
+     if (Index >= 0 && Index <= iFramesLast) {
+        int i = FindIFrame(Index);
+        if (!Forward && (i >= iFrames.Size() || iFrames[i] > Index))
+           i--; // the previous independent frame
+        if (i >= 0 && i < iFrames.Size()) {
+           Index = iFrames[i];
+           uint16_t fn;
+           if (!FileNumber)
+              FileNumber = &fn;
+           off_t fo;
+           if (!FileOffset)
+              FileOffset = &fo;
+           *FileNumber = index[Index].number;
+           *FileOffset = index[Index].offset;
+           if (Length) {
+              if (Index < last) {
+                 uint16_t fn = index[Index + 1].number;
+                 off_t fo = index[Index + 1].offset;
+                 if (fn == *FileNumber)
+                    *Length = int(fo - *FileOffset);
+                 else
+                    *Length = -1; // this means "everything up to EOF" (the buffer's Read function will act accordingly)
+                 }
+              else
+                 *Length = -1;
+              }
+           return Index;
+           }
+        }
      }
   return -1;
 }
@@ -2795,27 +4315,18 @@ int cIndexFile::GetNextIFrame(int Index, bool Forward, uint16_t *FileNumber, off
 int cIndexFile::GetClosestIFrame(int Index)
 {
   if (last > 0) {
-     Index = constrain(Index, 0, last);
-     if (index[Index].independent)
+     cMutexLock MutexLock(&mutex);
+     UpdateIFrames();
+     Index = constrain(Index, 0, iFramesLast);
+     int i = FindIFrame(Index);
+     int ih = i < iFrames.Size() ? iFrames[i] : -1;
+     if (ih == Index)
         return Index;
-     int il = Index - 1;
-     int ih = Index + 1;
-     for (;;) {
-         if (il >= 0) {
-            if (index[il].independent)
-               return il;
-            il--;
-            }
-         else if (ih > last)
-            break;
-         if (ih <= last) {
-            if (index[ih].independent)
-               return ih;
-            ih++;
-            }
-         else if (il < 0)
-            break;
-         }
+     int il = i > 0 ? iFrames[i - 1] : -1;
+     if (il >= 0 && (ih < 0 || Index - il <= ih - Index))
+        return il;
+     if (ih >= 0)
+        return ih;
      }
   return 0;
 }
@@ -2995,14 +4506,20 @@ cUnbufferedFile *cFileName::Open(void)
   return file;
 }
 
-void cFileName::Close(void)
+bool cFileName::Close(void)
 {
+  bool Result = true;
   if (file) {
-     if (file->Close() < 0)
+     if (file->Close() < 0) {
         LOG_ERROR_STR(fileName);
+        Result = false;
+        }
+     int Errno = errno;
      delete file;
      file = NULL;
+     errno = Errno;
      }
+  return Result;
 }
 
 cUnbufferedFile *cFileName::SetOffset(int Number, off_t Offset)
@@ -3052,6 +4569,521 @@ cUnbufferedFile *cFileName::NextFile(void)
   return SetOffset(fileNumber + 1);
 }
 
+// --- cRecordingReaderWorker ------------------------------------------------
+
+class cRecordingReaderWorker : public cThread {
+private:
+  cRecordingReader *reader;
+protected:
+  virtual void Action(void);
+public:
+  cRecordingReaderWorker(cRecordingReader *Reader, bool LowPriority);
+  virtual ~cRecordingReaderWorker();
+  };
+
+cRecordingReaderWorker::cRecordingReaderWorker(cRecordingReader *Reader, bool LowPriority)
+:cThread("recording reader", LowPriority)
+{
+  reader = Reader;
+  Start();
+}
+
+cRecordingReaderWorker::~cRecordingReaderWorker()
+{
+  Cancel(3);
+}
+
+void cRecordingReaderWorker::Action(void)
+{
+  while (Running())
+        reader->ReadNext(100);
+}
+
+// --- cRecordingReader ------------------------------------------------------
+
+#define READERCACHEKEEP MEGABYTE(8) // the amount of data around the replay position that is kept in the page cache (like READCHUNK in tools.c)
+
+cRecordingReader::cRecordingReader(const char *FileName, bool IsPesRecording, bool LowPriority)
+{
+  fileName = FileName;
+  isPesRecording = IsPesRecording;
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++) {
+      reads[i].state = rsFree;
+      reads[i].discard = false;
+      reads[i].buffer = NULL;
+      reads[i].size = 0;
+      }
+  for (int i = 0; i < int(sizeof(files) / sizeof(files[0])); i++) {
+      files[i].number = 0;
+      files[i].fd = -1;
+      files[i].users = 0;
+      }
+  numPool = 0;
+  cachedFileNumber = 0;
+  cachedStart = cachedEnd = 0;
+  serial = 0;
+  current = -1;
+  aheadIndex = -1;
+  for (int i = 0; i < READAHEADTHREADS; i++)
+      workers[i] = new cRecordingReaderWorker(this, LowPriority);
+}
+
+cRecordingReader::~cRecordingReader()
+{
+  for (int i = 0; i < READAHEADTHREADS; i++)
+      delete workers[i];
+  if (cachedFileNumber)
+     DropCache(cachedFileNumber, 0, 0);
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++)
+      free(reads[i].buffer);
+  for (int i = 0; i < numPool; i++)
+      free(pool[i].buffer);
+  for (int i = 0; i < int(sizeof(files) / sizeof(files[0])); i++) {
+      if (files[i].fd >= 0)
+         close(files[i].fd);
+      }
+}
+
+int cRecordingReader::Find(uint16_t FileNumber, off_t FileOffset)
+{
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++) {
+      tRead &r = reads[i];
+      if (r.state != rsFree && !r.discard && r.fileNumber == FileNumber && r.fileOffset == FileOffset)
+         return i;
+      }
+  return -1;
+}
+
+int cRecordingReader::Queue(uint16_t FileNumber, off_t FileOffset, int Length)
+{
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++) {
+      tRead &r = reads[i];
+      if (r.state == rsFree) {
+         r.discard = false;
+         r.serial = serial++;
+         r.fileNumber = FileNumber;
+         r.fileOffset = FileOffset;
+         r.length = Length;
+         r.result = 0;
+         r.error = 0;
+         r.state = rsQueued;
+         readQueued.Broadcast();
+         return i;
+         }
+      }
+  return -1;
+}
+
+void cRecordingReader::Discard(int Slot)
+{
+  tRead &r = reads[Slot];
+  if (r.state == rsReading)
+     r.discard = true; // the worker will free it when done
+  else
+     r.state = rsFree; // the buffer is kept for the next read
+}
+
+int cRecordingReader::OpenFile(uint16_t FileNumber)
+{
+  // The caller must hold the mutex.
+  tFile *Free = NULL;
+  for (int i = 0; i < int(sizeof(files) / sizeof(files[0])); i++) {
+      tFile &f = files[i];
+      if (f.fd >= 0 && f.number == FileNumber) {
+         f.users++;
+         return f.fd;
+         }
+      if (!f.users && (!Free || Free->fd >= 0))
+         Free = &f; // there is always one, since there is one more file than workers
+      }
+  if (Free->fd >= 0)
+     close(Free->fd);
+  cString Name = cString::sprintf(isPesRecording ? "%s" RECORDFILESUFFIXPES : "%s" RECORDFILESUFFIXTS, *fileName, FileNumber);
+  Free->number = FileNumber;
+  Free->fd = open(Name, O_RDONLY | O_LARGEFILE);
+  if (Free->fd >= 0) {
+     posix_fadvise(Free->fd, 0, 0, POSIX_FADV_RANDOM); // we do our own readahead
+     Free->users++;
+     }
+  else if (errno != ENOENT)
+     LOG_ERROR_STR(*Name);
+  return Free->fd;
+}
+
+void cRecordingReader::CloseFile(int fd)
+{
+  // The caller must hold the mutex.
+  for (int i = 0; i < int(sizeof(files) / sizeof(files[0])); i++) {
+      if (files[i].fd == fd) {
+         files[i].users--;
+         break;
+         }
+      }
+}
+
+uchar *cRecordingReader::GetBuffer(int Length, int &Size)
+{
+  // The caller must hold the mutex.
+  for (int i = 0; i < numPool; i++) {
+      if (pool[i].size >= Length && pool[i].size <= 2 * Length) {
+         uchar *Buffer = pool[i].buffer;
+         Size = pool[i].size;
+         pool[i] = pool[--numPool];
+         return Buffer;
+         }
+      }
+  uchar *Buffer = MALLOC(uchar, Length);
+  Size = Buffer ? Length : 0;
+  return Buffer;
+}
+
+void cRecordingReader::PutBuffer(uchar *Buffer, int Size)
+{
+  // The caller must hold the mutex.
+  if (Buffer) {
+     if (numPool < int(sizeof(pool) / sizeof(pool[0]))) {
+        pool[numPool].buffer = Buffer;
+        pool[numPool].size = Size;
+        numPool++;
+        }
+     else
+        free(Buffer);
+     }
+}
+
+void cRecordingReader::DropCache(uint16_t FileNumber, off_t Offset, off_t Length)
+{
+  // The caller must hold the mutex.
+  int fd = OpenFile(FileNumber);
+  if (fd >= 0) {
+     posix_fadvise(fd, Offset, Length, POSIX_FADV_DONTNEED); // Length 0 means up to the end of the file
+     CloseFile(fd);
+     }
+}
+
+void cRecordingReader::Delivered(uint16_t FileNumber, off_t Offset, int Length)
+{
+  // The caller must hold the mutex.
+  // The data has been copied into our own buffers, so, like cUnbufferedFile::Read(),
+  // we only keep the data around the current position in the page cache, instead of
+  // filling it with every recording that is replayed:
+  if (FileNumber != cachedFileNumber) {
+     if (cachedFileNumber)
+        DropCache(cachedFileNumber, 0, 0);
+     cachedFileNumber = FileNumber;
+     cachedStart = Offset;
+     cachedEnd = Offset + Length;
+     return;
+     }
+  cachedStart = min(cachedStart, Offset);
+  cachedEnd = max(cachedEnd, Offset + Length);
+  if (Offset - cachedStart > READERCACHEKEEP * 2) {
+     // current position has moved forward enough, shrink tail window
+     DropCache(FileNumber, cachedStart, Offset - READERCACHEKEEP - cachedStart);
+     cachedStart = Offset - READERCACHEKEEP;
+     }
+  else if (cachedEnd - (Offset + Length) > READERCACHEKEEP * 2) {
+     // current position has moved back enough, shrink head window
+     DropCache(FileNumber, Offset + Length + READERCACHEKEEP, cachedEnd - (Offset + Length + READERCACHEKEEP));
+     cachedEnd = Offset + Length + READERCACHEKEEP;
+     }
+}
+
+bool cRecordingReader::ReadNext(int TimeoutMs)
+{
+  cMutexLock MutexLock(&mutex);
+  int Slot = -1;
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++) {
+      if (reads[i].state == rsQueued && (Slot < 0 || reads[i].serial < reads[Slot].serial))
+         Slot = i;
+      }
+  if (Slot < 0) {
+     readQueued.TimedWait(mutex, TimeoutMs);
+     return false;
+     }
+  tRead &r = reads[Slot];
+  r.state = rsReading;
+  if (!r.buffer || r.size < r.length || r.size > 2 * r.length) {
+     PutBuffer(r.buffer, r.size);
+     r.buffer = GetBuffer(r.length, r.size);
+     }
+  int fd = OpenFile(r.fileNumber);
+  if (fd >= 0 && r.buffer) {
+     uchar *Buffer = r.buffer;
+     int Length = r.length;
+     off_t Offset = r.fileOffset;
+     mutex.Unlock();
+     int Result = 0;
+     int Error = 0;
+     while (Result < Length) {
+           ssize_t n = pread(fd, Buffer + Result, Length - Result, Offset + Result);
+           if (n > 0)
+              Result += n;
+           else if (n == 0) // EOF
+              break;
+           else if (errno != EINTR) {
+              Error = errno;
+              Result = -1;
+              break;
+              }
+           }
+     mutex.Lock();
+     CloseFile(fd);
+     r.result = Result;
+     r.error = Error;
+     }
+  else if (fd < 0) {
+     // a missing file means we're at the end of the recording:
+     r.result = errno == ENOENT ? 0 : -1;
+     r.error = errno;
+     }
+  else {
+     r.result = -1;
+     r.error = ENOMEM;
+     }
+  if (r.discard) {
+     r.discard = false;
+     r.state = rsFree;
+     }
+  else
+     r.state = rsDone;
+  readDone.Broadcast();
+  return true;
+}
+
+void cRecordingReader::Clear(void)
+{
+  cMutexLock MutexLock(&mutex);
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++) {
+      if (reads[i].state != rsFree)
+         Discard(i);
+      }
+  current = -1;
+  aheadIndex = -1;
+}
+
+void cRecordingReader::Request(uint16_t FileNumber, off_t FileOffset, int Length)
+{
+  cMutexLock MutexLock(&mutex);
+  current = Find(FileNumber, FileOffset);
+  if (current >= 0 && reads[current].length != Length)
+     current = -1; // the caller has a different idea of this frame
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++) {
+      if (reads[i].state != rsFree && i != current && (current < 0 || reads[i].serial < reads[current].serial))
+         Discard(i);
+      }
+  if (current < 0) {
+     aheadIndex = -1;
+     while ((current = Queue(FileNumber, FileOffset, Length)) < 0)
+           readDone.Wait(mutex); // all slots are occupied by discarded reads that are still in progress
+     }
+}
+
+int cRecordingReader::Result(uchar **Buffer)
+{
+  cMutexLock MutexLock(&mutex);
+  if (current >= 0 && reads[current].state == rsDone) {
+     tRead &r = reads[current];
+     int Result = r.result;
+     if (Result > 0) {
+        Delivered(r.fileNumber, r.fileOffset, Result);
+        *Buffer = r.buffer;
+        r.buffer = NULL;
+        r.size = 0;
+        }
+     else if (Result < 0)
+        errno = r.error;
+     r.state = rsFree;
+     current = -1;
+     return Result;
+     }
+  errno = EAGAIN;
+  return -1;
+}
+
+void cRecordingReader::Recycle(uchar *Buffer, int Size)
+{
+  cMutexLock MutexLock(&mutex);
+  PutBuffer(Buffer, Size);
+}
+
+bool cRecordingReader::Reading(void)
+{
+  cMutexLock MutexLock(&mutex);
+  return current >= 0;
+}
+
+bool cRecordingReader::WaitForDataMs(int msToWait)
+{
+  cMutexLock MutexLock(&mutex);
+  if (current >= 0 && reads[current].state == rsDone)
+     return true;
+  return readDone.TimedWait(mutex, msToWait);
+}
+
+bool cRecordingReader::Prefetch(uint16_t FileNumber, off_t FileOffset, int Length)
+{
+  cMutexLock MutexLock(&mutex);
+  if (Find(FileNumber, FileOffset) >= 0)
+     return true;
+  int Pending = 0;
+  for (int i = 0; i < int(sizeof(reads) / sizeof(reads[0])); i++) {
+      if (reads[i].state != rsFree && !reads[i].discard && i != current)
+         Pending++;
+      }
+  return Pending < READAHEADFRAMES && Queue(FileNumber, FileOffset, Length) >= 0;
+}
+
+void cRecordingReader::ReadAhead(cIndexFile *IndexFile, int Index)
+{
+  cMutexLock MutexLock(&mutex);
+  if (aheadIndex < Index)
+     aheadIndex = Index;
+  int Last = IndexFile->Last();
+  if (IndexFile->IsStillRecording())
+     Last -= READAHEADFRAMES; // the latest frames may not yet have been completely written
+  while (aheadIndex <= Last && aheadIndex < Index + READAHEADFRAMES) {
+        uint16_t FileNumber;
+        off_t FileOffset;
+        int Length;
+        if (!IndexFile->Get(aheadIndex, &FileNumber, &FileOffset, NULL, &Length) || Length <= 0 || Length > MAXFRAMESIZE)
+           break; // frames that are read up to the end of the file are not read ahead
+        if (!Prefetch(FileNumber, FileOffset, Length))
+           break;
+        aheadIndex++;
+        }
+}
+
+// --- cRecordingSegments ---------------------------------------------------
+
+cRecordingSegments::cRecordingSegments(const cRecording *Recording)
+{
+  fileName = Recording->FileName();
+  isPesRecording = Recording->IsPesRecording();
+  framesPerSecond = Recording->FramesPerSecond();
+  indexFile = new cIndexFile(fileName, false, isPesRecording);
+  if (!indexFile->Ok())
+     DELETENULL(indexFile);
+}
+
+cRecordingSegments::~cRecordingSegments()
+{
+  Clear();
+  for (int i = 0; i < fds.Size(); i++)
+      close(fds[i]);
+  delete indexFile;
+}
+
+int cRecordingSegments::OpenFile(uint16_t FileNumber)
+{
+  int i = fileNumbers.IndexOf(FileNumber);
+  if (i >= 0)
+     return fds[i];
+  cString Name = cString::sprintf(isPesRecording ? "%s" RECORDFILESUFFIXPES : "%s" RECORDFILESUFFIXTS, *fileName, FileNumber);
+  int fd = open(Name, O_RDONLY | O_LARGEFILE);
+  if (fd >= 0) {
+     fileNumbers.Append(FileNumber);
+     fds.Append(fd);
+     }
+  else
+     LOG_ERROR_STR(*Name);
+  return fd;
+}
+
+bool cRecordingSegments::SetIndexRange(int FromIndex, int ToIndex)
+{
+  Clear();
+  if (!indexFile)
+     return false;
+  int Last = indexFile->Last();
+  if (indexFile->IsStillRecording())
+     Last--; // the last frame may not be complete, yet
+  if (ToIndex < 0 || ToIndex > Last)
+     ToIndex = Last;
+  FromIndex = max(FromIndex, 0);
+  if (FromIndex > ToIndex)
+     return false;
+  uint16_t FromNumber, ToNumber;
+  off_t FromOffset, ToOffset;
+  if (!indexFile->Get(FromIndex, &FromNumber, &FromOffset))
+     return false;
+  if (ToIndex < indexFile->Last()) {
+     // The range ends where the next frame begins:
+     if (!indexFile->Get(ToIndex + 1, &ToNumber, &ToOffset))
+        return false;
+     }
+  else {
+     // The range ends at the end of the last file:
+     if (!indexFile->Get(ToIndex, &ToNumber, &ToOffset))
+        return false;
+     ToOffset = -1;
+     }
+  for (int Number = FromNumber; Number <= ToNumber; Number++) {
+      int fd = OpenFile(Number);
+      if (fd < 0) {
+         Clear();
+         return false;
+         }
+      off_t Begin = (Number == FromNumber) ? FromOffset : 0;
+      off_t End = ToOffset;
+      if (Number != ToNumber || End < 0) {
+         struct stat st;
+         if (fstat(fd, &st) < 0) {
+            LOG_ERROR;
+            Clear();
+            return false;
+            }
+         End = st.st_size;
+         }
+      if (End > Begin)
+         Add(new cRecordingSegment(fd, Number, Begin, End - Begin));
+      }
+  return Count() > 0;
+}
+
+bool cRecordingSegments::SetTimeRange(int FromSeconds, int ToSeconds)
+{
+  int FromIndex = SecondsToFrames(FromSeconds, framesPerSecond);
+  int ToIndex = ToSeconds >= 0 ? SecondsToFrames(ToSeconds, framesPerSecond) - 1 : -1;
+  if (indexFile && FromIndex > 0)
+     FromIndex = max(indexFile->GetNextIFrame(FromIndex + 1, false), 0);
+  return SetIndexRange(FromIndex, ToIndex);
+}
+
+off_t cRecordingSegments::Length(void) const
+{
+  off_t Length = 0;
+  for (const cRecordingSegment *Segment = First(); Segment; Segment = Next(Segment))
+      Length += Segment->Length();
+  return Length;
+}
+
+bool cRecordingSegments::Send(int Fd) const
+{
+  for (const cRecordingSegment *Segment = First(); Segment; Segment = Next(Segment)) {
+      off_t Offset = Segment->Offset();
+      off_t End = Offset + Segment->Length();
+      while (Offset < End) {
+            ssize_t n = sendfile(Fd, Segment->Fd(), &Offset, min(End - Offset, off_t(MEGABYTE(16))));
+            if (n < 0) {
+               if (errno == EAGAIN) {
+                  cPoller Poller(Fd, true);
+                  Poller.Poll(100);
+                  }
+               else if (errno != EINTR) {
+                  LOG_ERROR;
+                  return false;
+                  }
+               }
+            else if (n == 0) {
+               esyslog("ERROR: unexpected end of file %d of %s", Segment->FileNumber(), *fileName);
+               return false;
+               }
+            }
+      }
+  return true;
+}
+
 // --- cDoneRecordings -------------------------------------------------------
 
 cDoneRecordings DoneRecordingsPattern;
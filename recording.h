@@ -38,9 +38,13 @@ enum eRecordingUsage {
   ruDst      = 0x0040, // the recording is the destination of a cut, move or copy process
   //
   ruPending  = 0x0080, // the recording is pending a cut, move or copy process
+  ruRemove   = 0x0100, // the (deleted) recording is being removed from the disk
   ruCanceled = 0x8000, // the operation has been canceled, waiting for cleanup
   };
 
+enum eRecordingsSortDir { rsdAscending, rsdDescending };
+enum eRecordingsSortMode { rsmName, rsmTime };
+
 void RemoveDeletedRecordings(void);
 void AssertFreeDiskSpace(int Priority = 0, bool Force = false);
      ///< The special Priority value -1 means that we shall get rid of any
@@ -97,12 +101,22 @@ public:
 
 class cRecording : public cListObject {
   friend class cRecordings;
+  friend class cRecordingsCache;
+  friend class cRecordingsSortIndex;
+  friend class cRecordingsReclaimer;
 private:
   int id;
   mutable int resume;
   mutable char *titleBuffer;
   mutable char *sortBufferName;
   mutable char *sortBufferTime;
+  int sortNameVersion; // incremented whenever the sort names are cleared
+  static int fileNameChanges; // incremented whenever the file name of any recording changes (accessed atomically)
+  static void FileNameChanged(void) { __atomic_add_fetch(&fileNameChanges, 1, __ATOMIC_RELAXED); }
+  static int FileNameChanges(void) { return __atomic_load_n(&fileNameChanges, __ATOMIC_RELAXED); }
+  static int sizeChanges; // incremented whenever the size or length of any recording changes (accessed atomically)
+  static void SizeChanged(void) { __atomic_add_fetch(&sizeChanges, 1, __ATOMIC_RELAXED); }
+  static int SizeChanges(void) { return __atomic_load_n(&sizeChanges, __ATOMIC_RELAXED); }
   mutable char *fileName;
   mutable char *name;
   mutable int fileSizeMB;
@@ -117,8 +131,13 @@ private:
   cRecording &operator=(const cRecording &); // can't assign cRecording
   static char *StripEpisodeName(char *s, bool Strip);
   char *SortName(void) const;
+  char *SortName(eRecordingsSortMode SortMode) const;
   void ClearSortName(void);
   void SetId(int Id); // should only be set by cRecordings
+  cRecording(const char *FileName, FILE *InfoFile);
+       ///< Used by cRecordingsCache to create a recording with the info data from
+       ///< the given InfoFile instead of the recording's actual info file.
+  void Initialize(const char *FileName, FILE *InfoFile);
   time_t start;
   int priority;
   int lifetime;
@@ -208,8 +227,9 @@ public:
        ///< Returns false in case of error
   bool Undelete(void);
        ///< Changes the file name so that it will be visible in the "Recordings" menu again and
-       ///< not processed by cRemoveDeletedRecordingsThread.
-       ///< Returns false in case of error
+       ///< not processed by RemoveDeletedRecordings().
+       ///< Returns false in case of error (or if the recording is already being
+       ///< removed from the disk)
   int IsInUse(void) const;
        ///< Checks whether this recording is currently in use and therefore shall not
        ///< be tampered with. Returns 0 (ruNone) if the recording is not in use.
@@ -221,6 +241,8 @@ public:
   };
 
 class cVideoDirectoryScannerThread;
+class cVideoDirectoryWatcher;
+class cRecordingsSortIndex;
 
 class cRecordings : public cList<cRecording> {
 private:
@@ -228,9 +250,21 @@ private:
   static cRecordings deletedRecordings;
   static int lastRecordingId;
   static char *updateFileName;
+  static char *cacheFileName;
   static time_t lastUpdate;
   static cVideoDirectoryScannerThread *videoDirectoryScannerThread;
+  static cVideoDirectoryWatcher *videoDirectoryWatcher;
   static const char *UpdateFileName(void);
+  mutable cMutex indexMutex;
+  mutable cRecordingsSortIndex *sortIndex[2]; // indexed by eRecordingsSortMode
+  mutable cHash<cRecording> recordingsByName;
+  mutable int nameIndexVersion; // the value of cRecording::fileNameChanges the name index is based on
+  cHash<cRecording> recordingsById;
+  void UpdateNameIndex(void) const;
+  mutable int totalFileSizeMB;
+  mutable double mbPerMinute;
+  mutable int totalsVersion; // the value of cRecording::sizeChanges the totals are based on
+  void UpdateTotals(void) const;
 public:
   cRecordings(bool Deleted = false);
   virtual ~cRecordings();
@@ -255,17 +289,53 @@ public:
        ///< instances of VDR that access the same video directory can be triggered
        ///< to update their recordings list.
   static bool NeedsUpdate(void);
+       ///< Returns true if the list of recordings needs to be updated by a call
+       ///< to Update(). This is the case if the ".update" file has been touched
+       ///< (see TouchUpdate()), or if the video directory watcher (which applies
+       ///< changes in the video directory directly to the list of recordings) has
+       ///< lost track of these changes.
+  static void SetCacheFileName(const char *FileName);
+       ///< Sets the name of the file in which the data of all recordings is cached
+       ///< between program runs, so that the initial scan of the video directory
+       ///< only needs to read the data of recordings that have changed.
+  static const char *CacheFileName(void) { return cacheFileName; }
   void ResetResume(const char *ResumeFileName = NULL);
   void ClearSortNames(void);
   const cRecording *GetById(int Id) const;
   cRecording *GetById(int Id) { return const_cast<cRecording *>(static_cast<const cRecordings *>(this)->GetById(Id)); };
   const cRecording *GetByName(const char *FileName) const;
   cRecording *GetByName(const char *FileName) { return const_cast<cRecording *>(static_cast<const cRecordings *>(this)->GetByName(FileName)); }
+  const cVector<const cRecording *> &Sorted(void) const;
+       ///< Returns the recordings in this list, sorted according to the current
+       ///< RecordingsSortMode (in the same order cListBase::Sort() would put them,
+       ///< see cRecording::Compare()). The sort index this is taken from is kept
+       ///< up to date when recordings are added, deleted or renamed, so calling
+       ///< this function repeatedly doesn't sort the whole list each time.
+       ///< The returned vector may only be used as long as the caller holds a lock
+       ///< on this list, and must not be kept beyond that.
+  virtual void Clear(void);
   void Add(cRecording *Recording);
+  void Del(cRecording *Recording, bool DeleteObject = true);
   void AddByName(const char *FileName, bool TriggerUpdate = true);
   void DelByName(const char *FileName);
   void UpdateByName(const char *FileName);
+  void SetRecordingSize(const char *FileName, int NumFrames, int FileSizeMB);
+       ///< Sets the number of frames and the total size of the files (in MB) of the
+       ///< recording with the given FileName, which is currently being written by
+       ///< a recorder or cutter that knows these values without having to check the
+       ///< actual files. The caller must hold a write lock on this list.
+  static void UpdateRecordingSize(const char *FileName, int NumFrames, int FileSizeMB);
+       ///< Calls SetRecordingSize() on the global list of recordings. If that list
+       ///< can't be locked within a few milliseconds, the update is skipped, so it
+       ///< should be repeated every RECORDINGSIZEUPDATE seconds while writing. Since
+       ///< this is done by the thread that writes the recording, it must never wait
+       ///< for the lock (its owner may hold it while stopping the thread). Therefore
+       ///< the owner shall call SetRecordingSize() with the final values after the
+       ///< thread has ended.
   int TotalFileSizeMB(void) const;
+       ///< Returns the total size (in MB) of all recordings in this list that are
+       ///< stored on the video directory's file system. The totals are only computed
+       ///< anew if the size of any recording has changed since the last call.
   double MBperMinute(void) const;
        ///< Returns the average data rate (in MB/min) of all recordings, or -1 if
        ///< this value is unknown.
@@ -307,11 +377,13 @@ DEF_LIST_LOCK2(Recordings, DeletedRecordings);
 #define LOCK_DELETEDRECORDINGS_WRITE USE_LIST_LOCK_WRITE2(Recordings, DeletedRecordings)
 
 class cRecordingsHandlerEntry;
+class cRecordingsReclaimer;
 
 class cRecordingsHandler : public cThread {
 private:
   cMutex mutex;
   cList<cRecordingsHandlerEntry> operations;
+  cRecordingsReclaimer *reclaimer;
   bool finished;
   bool error;
   cRecordingsHandlerEntry *Get(const char *FileName);
@@ -337,6 +409,19 @@ public:
        ///< Deletes/terminates all operations.
   int GetUsage(const char *FileName);
        ///< Returns the usage type for the given FileName.
+  bool Remove(const char *FileName, int FileSizeMB = -1);
+       ///< Adds the deleted recording with the given FileName to the list of
+       ///< recordings that are removed from the disk in the background. Its files
+       ///< are truncated in steps (and only as long as the recorders don't suffer
+       ///< from I/O throttling) before they are unlinked, so that freeing a lot of
+       ///< disk space at once doesn't stall the file system. FileSizeMB is only
+       ///< used for reporting how much disk space is yet to be freed.
+       ///< While the recording is being removed, GetUsage() reports ruRemove for it.
+       ///< Returns true if the recording has been added, or is already in the list.
+  bool Reclaiming(int *RemainingMB = NULL);
+       ///< Returns true if any deleted recordings are currently being removed from
+       ///< the disk. If RemainingMB is given, it will receive the amount of disk
+       ///< space (in MB) that has yet to be freed.
   bool Finished(bool &Error);
        ///< Returns true if all operations in the list have been finished.
        ///< If there have been any errors, Errors will be set to true.
@@ -447,6 +532,10 @@ public:
 #define MINVIDEOFILESIZE        100 // MB
 #define MAXVIDEOFILESIZEDEFAULT MAXVIDEOFILESIZEPES
 
+#define MAXVIDEODIRSCANTHREADS   16 // the maximum number of threads scanning the video directory
+
+#define RECORDINGSIZEUPDATE      10 // seconds between updates of the size of a recording that is being written
+
 struct tIndexTs;
 class cIndexFileGenerator;
 
@@ -456,10 +545,20 @@ private:
   cString fileName;
   int size, last;
   tIndexTs *index;
+  bool mapped;
   bool isPesRecording;
   cResumeFile resumeFile;
   cIndexFileGenerator *indexFileGenerator;
   cMutex mutex;
+  cVector<int> iFrames; // the indexes of all independent frames up to iFramesLast
+  int iFramesLast;
+  void UpdateIFrames(void);
+  int FindIFrame(int Index);
+       ///< Returns the position in iFrames of the first independent frame at or after
+       ///< Index, or iFrames.Size() if there is no such frame.
+  bool MapIndex(int Size);
+       ///< Maps (or remaps) the index file read-only into memory, with room for at
+       ///< least Size entries. Only used for TS recordings that are being replayed.
   void ConvertFromPes(tIndexTs *IndexTs, int Count);
   void ConvertToPes(tIndexTs *IndexTs, int Count);
   bool CatchUp(int Index = -1);
@@ -503,11 +602,162 @@ public:
   uint16_t Number(void) { return fileNumber; }
   bool GetLastPatPmtVersions(int &PatVersion, int &PmtVersion);
   cUnbufferedFile *Open(void);
-  void Close(void);
+  bool Close(void);
+       ///< Closes the current file and returns true if this was successful.
+       ///< A failure, in particular of any outstanding asynchronous write, is logged
+       ///< and leaves errno set accordingly.
   cUnbufferedFile *SetOffset(int Number, off_t Offset = 0); // yes, Number is int for easier internal calculating
   cUnbufferedFile *NextFile(void);
   };
 
+#define READAHEADFRAMES  16 // the maximum number of frames a cRecordingReader reads ahead
+#define READAHEADTHREADS  3 // the number of threads that do the actual reading
+
+class cRecordingReaderWorker;
+
+class cRecordingReader {
+  friend class cRecordingReaderWorker;
+private:
+  enum { rsFree, rsQueued, rsReading, rsDone };
+  struct tRead {
+    int state;
+    bool discard; // the data is no longer needed (only while rsReading)
+    int serial; // the order in which the reads have been requested
+    uint16_t fileNumber;
+    off_t fileOffset;
+    int length;
+    uchar *buffer;
+    int size; // the allocated size of buffer
+    int result; // the number of bytes read, or -1 in case of an error
+    int error; // the errno in case of an error
+    };
+  struct tFile {
+    uint16_t number;
+    int fd;
+    int users;
+    };
+  struct tBuffer {
+    uchar *buffer;
+    int size;
+    };
+  cString fileName;
+  bool isPesRecording;
+  cMutex mutex;
+  cCondVar readQueued;
+  cCondVar readDone;
+  tRead reads[READAHEADFRAMES * 2];
+  tFile files[READAHEADTHREADS + 1];
+  tBuffer pool[READAHEADFRAMES]; // buffers that can be reused for later reads
+  int numPool;
+  uint16_t cachedFileNumber; // the file the data in the page cache belongs to
+  off_t cachedStart, cachedEnd; // the range of that file that has been delivered
+  int serial;
+  int current; // the read requested by Request(), or -1
+  int aheadIndex; // the next frame to be read ahead by ReadAhead(), or -1
+  cRecordingReaderWorker *workers[READAHEADTHREADS];
+  int Find(uint16_t FileNumber, off_t FileOffset);
+  int Queue(uint16_t FileNumber, off_t FileOffset, int Length);
+  void Discard(int Slot);
+  int OpenFile(uint16_t FileNumber);
+  void CloseFile(int fd);
+  uchar *GetBuffer(int Length, int &Size);
+  void PutBuffer(uchar *Buffer, int Size);
+  void DropCache(uint16_t FileNumber, off_t Offset, off_t Length);
+  void Delivered(uint16_t FileNumber, off_t Offset, int Length);
+  bool ReadNext(int TimeoutMs);
+public:
+  cRecordingReader(const char *FileName, bool IsPesRecording = false, bool LowPriority = false);
+       ///< Creates a reader that reads the frames of the recording with the given
+       ///< FileName with a small pool of threads, so that several reads can be in
+       ///< flight at the same time. If LowPriority is true, these threads run with
+       ///< low priority (see cThread), which should be used for background jobs
+       ///< like cutting.
+  ~cRecordingReader();
+  void Clear(void);
+       ///< Discards all reads, including the ones that are still in progress.
+  void Request(uint16_t FileNumber, off_t FileOffset, int Length);
+       ///< Requests Length bytes, starting at FileOffset in the file with the given
+       ///< FileNumber. If this data has already been read ahead, it is taken from
+       ///< there, and any data that has been read ahead of it is discarded (since the
+       ///< caller has obviously skipped it). Otherwise all data that has been read
+       ///< ahead is discarded.
+  int Result(uchar **Buffer);
+       ///< Returns the number of bytes of the data requested by the last call to
+       ///< Request() and hands the buffer containing it over to the caller, who
+       ///< has to free() it, or give it back with Recycle(). Returns 0 at the end of
+       ///< the file, and -1 in case of an error, with errno set to EAGAIN if the data
+       ///< is not yet available.
+  void Recycle(uchar *Buffer, int Size);
+       ///< Gives a Buffer that has been returned by Result() back to this reader,
+       ///< which will use it for a later read instead of allocating a new one.
+       ///< Size is the number of bytes Result() has returned along with it.
+  bool Reading(void);
+       ///< Returns true if Result() has not yet delivered the data requested by the
+       ///< last call to Request().
+  bool WaitForDataMs(int msToWait);
+       ///< Waits at most msToWait milliseconds for the requested data to become
+       ///< available. Returns true if it (or any other data) has become available.
+  bool Prefetch(uint16_t FileNumber, off_t FileOffset, int Length);
+       ///< Starts reading the given data ahead of time, so that it is readily
+       ///< available to a later Request(). Returns false if no more reads can be
+       ///< started at the moment.
+  void ReadAhead(cIndexFile *IndexFile, int Index);
+       ///< Reads ahead up to READAHEADFRAMES frames, starting with the frame at the
+       ///< given Index, as far as they haven't already been read ahead.
+  };
+
+class cRecordingSegment : public cListObject {
+private:
+  int fd;
+  uint16_t fileNumber;
+  off_t offset;
+  off_t length;
+public:
+  cRecordingSegment(int Fd, uint16_t FileNumber, off_t Offset, off_t Length) { fd = Fd; fileNumber = FileNumber; offset = Offset; length = Length; }
+  int Fd(void) const { return fd; }
+       ///< Returns the file descriptor of the file that contains this segment.
+       ///< The file is owned by the cRecordingSegments this segment belongs to.
+  uint16_t FileNumber(void) const { return fileNumber; }
+  off_t Offset(void) const { return offset; }
+  off_t Length(void) const { return length; }
+  };
+
+class cRecordingSegments : public cList<cRecordingSegment> {
+private:
+  cString fileName;
+  bool isPesRecording;
+  double framesPerSecond;
+  cIndexFile *indexFile;
+  cVector<int> fileNumbers;
+  cVector<int> fds;
+  int OpenFile(uint16_t FileNumber);
+public:
+  cRecordingSegments(const cRecording *Recording);
+       ///< Allows access to the data of the given Recording as a list of segments
+       ///< of its files, so that it can be sent with sendfile() or splice() without
+       ///< copying it into a buffer first. The Recording is only used to initialize
+       ///< this object, so the list of recordings need not remain locked.
+  virtual ~cRecordingSegments();
+  bool SetIndexRange(int FromIndex, int ToIndex = -1);
+       ///< Sets up the segments that contain the frames from FromIndex up to (and
+       ///< including) ToIndex. ToIndex -1 means up to the end of the recording.
+       ///< If the range covers several files, there is one segment per file.
+       ///< In a recording that is still being written, the last frame is left
+       ///< out, since it may not be complete, yet.
+       ///< Returns false if there is no such range (or no index).
+  bool SetTimeRange(int FromSeconds, int ToSeconds = -1);
+       ///< Like SetIndexRange(), but with the range given in seconds from the
+       ///< beginning of the recording. The range starts at the I-frame at or
+       ///< before FromSeconds, so that the data can be decoded.
+  off_t Length(void) const;
+       ///< Returns the total length of all segments.
+  bool Send(int Fd) const;
+       ///< Sends the data of all segments to the given Fd (typically a socket)
+       ///< with sendfile(). If Fd is in non-blocking mode, this function waits
+       ///< until it is ready for more data.
+       ///< Returns false in case of an error.
+  };
+
 class cDoneRecordings {
 private:
   cString fileName;
@@ -543,8 +793,6 @@ bool GenerateIndex(const char *FileName, bool Update = false);
        ///< complete, and will be updated if it isn't. Otherwise an existing index
        ///< file will be removed before a new one is generated.
 
-enum eRecordingsSortDir { rsdAscending, rsdDescending };
-enum eRecordingsSortMode { rsmName, rsmTime };
 extern eRecordingsSortMode RecordingsSortMode;
 bool HasRecordingsSortMode(const char *Directory);
 void GetRecordingsSortMode(const char *Directory);
@@ -277,41 +277,67 @@ void cTsPayload::Setup(uchar *Data, int Length, int Pid)
   Reset();
 }
 
-uchar cTsPayload::GetByte(void)
-{
-  if (!Eof()) {
-     if (index % TS_SIZE == 0) { // encountered the next TS header
-        for (;; index += TS_SIZE) {
-            if (data[index] == TS_SYNC_BYTE && index + TS_SIZE <= length) { // to make sure we are at a TS header start and drop incomplete TS packets at the end
-               uchar *p = data + index;
-               if (TsPid(p) == pid) { // only handle TS packets for the initial PID
-                  if (++numPacketsPid > MAX_TS_PACKETS_FOR_VIDEO_FRAME_DETECTION)
-                     return SetEof();
-                  if (TsHasPayload(p)) {
-                     if (index > 0 && TsPayloadStart(p)) // checking index to not skip the very first TS packet
-                        return SetEof();
-                     index += TsPayloadOffset(p);
-                     break;
-                     }
+bool cTsPayload::NextPayload(void)
+{
+  for (;; index += TS_SIZE) {
+      if (data[index] == TS_SYNC_BYTE && index + TS_SIZE <= length) { // to make sure we are at a TS header start and drop incomplete TS packets at the end
+         uchar *p = data + index;
+         if (TsPid(p) == pid) { // only handle TS packets for the initial PID
+            if (++numPacketsPid > MAX_TS_PACKETS_FOR_VIDEO_FRAME_DETECTION)
+               break;
+            if (TsHasPayload(p)) {
+               if (index > 0 && TsPayloadStart(p)) // checking index to not skip the very first TS packet
+                  break;
+               int Offset = TsPayloadOffset(p);
+               if (Offset < TS_SIZE) {
+                  index += Offset;
+                  return true;
                   }
-               else if (TsPid(p) == PATPID)
-                  return SetEof(); // caller must see PAT packets in case of index regeneration
-               else
-                  numPacketsOther++;
                }
-            else
-               return SetEof();
-           }
-        }
-     return data[index++];
+            }
+         else if (TsPid(p) == PATPID)
+            break; // caller must see PAT packets in case of index regeneration
+         else
+            numPacketsOther++;
+         }
+      else
+         break;
+      }
+  SetEof();
+  return false;
+}
+
+int cTsPayload::GetSpan(const uchar *&Data)
+{
+  if (!Eof() && (index % TS_SIZE || NextPayload())) {
+     Data = data + index;
+     return TS_SIZE - index % TS_SIZE;
      }
+  return 0;
+}
+
+void cTsPayload::Advance(int Bytes)
+{
+  index += Bytes;
+}
+
+uchar cTsPayload::GetByte(void)
+{
+  if (!Eof() && (index % TS_SIZE || NextPayload()))
+     return data[index++];
   return 0x00;
 }
 
 bool cTsPayload::SkipBytes(int Bytes)
 {
-  while (Bytes-- > 0)
-        GetByte();
+  const uchar *p;
+  while (Bytes > 0) {
+        int n = min(GetSpan(p), Bytes);
+        if (!n)
+           break;
+        Advance(n);
+        Bytes -= n;
+        }
   return !Eof();
 }
 
@@ -320,6 +346,30 @@ bool cTsPayload::SkipPesHeader(void)
   return SkipBytes(PesPayloadOffset(data + TsPayloadOffset(data)));
 }
 
+static int ScanToStartCode(const uchar *Data, int Length, uint32_t &Scanner)
+{
+  // Returns the number of bytes at the beginning of Data that can't complete a
+  // start code prefix (0x000001), and shifts the last of them into Scanner.
+  if ((Scanner & 0xFF) == 0x01)
+     return 0; // the byte following a 0x01 must always be read
+  // memchr() is typically vectorized, so this is much faster than looking at every single byte:
+  const uchar *p = (const uchar *)memchr(Data, 0x01, Length);
+  int n = p ? p - Data : Length;
+  for (int i = max(0, n - 4); i < n; i++)
+      Scanner = (Scanner << 8) | Data[i];
+  return n;
+}
+
+void cTsPayload::SkipToStartCode(uint32_t &Scanner)
+{
+  if (index % TS_SIZE) {
+     const uchar *p;
+     int n = GetSpan(p) - 1; // the last byte of a TS packet is always left to GetByte()
+     if (n > 0)
+        Advance(ScanToStartCode(p, n, Scanner));
+     }
+}
+
 int cTsPayload::GetLastIndex(void)
 {
   return index - 1;
@@ -337,10 +387,19 @@ bool cTsPayload::Find(uint32_t Code)
   int OldNumPacketsPid = numPacketsPid;
   int OldNumPacketsOther = numPacketsOther;
   uint32_t Scanner = EMPTY_SCANNER;
-  while (!Eof()) {
-        Scanner = (Scanner << 8) | GetByte();
-        if (Scanner == Code)
-           return true;
+  bool StartCode = (Code & 0xFFFFFF00) == 0x00000100;
+  const uchar *p;
+  while (int n = GetSpan(p)) {
+        for (int i = 0; i < n; i++) {
+            if (StartCode && (i += ScanToStartCode(p + i, n - i, Scanner)) >= n)
+               break;
+            Scanner = (Scanner << 8) | p[i];
+            if (Scanner == Code) {
+               Advance(i + 1);
+               return true;
+               }
+            }
+        Advance(n);
         }
   index = OldIndex;
   numPacketsPid = OldNumPacketsPid;
@@ -1255,6 +1314,7 @@ int cMpeg2Parser::Parse(const uchar *Data, int Length, int Pid)
      }
   uint32_t OldScanner = scanner; // need to remember it in case of multiple frames per payload
   for (;;) {
+      tsPayload.SkipToStartCode(scanner);
       if (!SeenPayloadStart && tsPayload.AtTsStart())
          OldScanner = scanner;
       scanner = (scanner << 8) | tsPayload.GetByte();
@@ -1421,6 +1481,7 @@ int cH264Parser::Parse(const uchar *Data, int Length, int Pid)
         }
      }
   for (;;) {
+      tsPayload.SkipToStartCode(scanner);
       scanner = (scanner << 8) | GetByte(true);
       if ((scanner & 0xFFFFFF00) == 0x00000100) { // NAL unit start
          uchar NalUnitType = scanner & 0x1F;
@@ -1589,6 +1650,7 @@ int cH265Parser::Parse(const uchar *Data, int Length, int Pid)
      scanner = EMPTY_SCANNER;
      }
   for (;;) {
+      tsPayload.SkipToStartCode(scanner);
       scanner = (scanner << 8) | GetByte(true);
       if ((scanner & 0xFFFFFF00) == 0x00000100) { // NAL unit start
          uchar NalUnitType = (scanner >> 1) & 0x3F;
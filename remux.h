@@ -232,6 +232,7 @@ private:
   int numPacketsPid; // the number of TS packets with the given PID (for statistical purposes)
   int numPacketsOther; // the number of TS packets with other PIDs (for statistical purposes)
   uchar SetEof(void);
+  bool NextPayload(void);
 protected:
   void Reset(void);
 public:
@@ -265,6 +266,18 @@ public:
        ///< May be called after a new frame has been detected, and will log a warning
        ///< if the number of TS packets required to determine the frame type exceeded
        ///< some safety limits.
+  int GetSpan(const uchar *&Data);
+       ///< Returns the number of payload bytes that directly follow each other in
+       ///< the current TS packet, starting at the current read position, and sets
+       ///< Data to point to the first of them. If the current TS packet has been
+       ///< completely read, this moves on to the payload of the next TS packet with
+       ///< the given PID, skipping any intermediate TS header data (just like GetByte()).
+       ///< Returns 0 if there is no more payload data.
+       ///< The read position is not changed by this function. Use Advance() to
+       ///< mark bytes as read.
+  void Advance(int Bytes);
+       ///< Advances the read position by the given number of Bytes, which must not be
+       ///< more than the value returned by the most recent call to GetSpan().
   uchar GetByte(void);
        ///< Gets the next byte of the TS payload, skipping any intermediate TS header data.
   bool SkipBytes(int Bytes);
@@ -272,6 +285,14 @@ public:
        ///< is still data left to read.
   bool SkipPesHeader(void);
        ///< Skips all bytes belonging to the PES header of the payload.
+  void SkipToStartCode(uint32_t &Scanner);
+       ///< Quickly skips all payload bytes of the current TS packet that can't be
+       ///< part of a start code (0x000001xx), and shifts the last skipped bytes into
+       ///< Scanner, as if they had been read one by one with GetByte(). The next
+       ///< call to GetByte() will return the next 0x01 byte of the current TS packet,
+       ///< or its last byte if there is no such byte. If the last byte in Scanner is
+       ///< 0x01, nothing is skipped. Data is never skipped across
+       ///< TS packet borders, so the caller still sees every TS packet start.
   int GetLastIndex(void);
        ///< Returns the index into the TS data of the payload byte that has most recently
        ///< been read. If no byte has been read yet, -1 will be returned.
@@ -31,6 +31,7 @@ cRingBuffer::cRingBuffer(int Size, bool Statistics)
   maxFill = 0;
   lastPercent = 0;
   putTimeout = getTimeout = 0;
+  putWaiting = getWaiting = false;
   lastOverflowReport = 0;
   overflowCount = overflowBytes = 0;
   ioThrottle = NULL;
@@ -62,27 +63,40 @@ void cRingBuffer::UpdatePercentage(int Fill)
      }
 }
 
+// WaitForPut() and WaitForGet() are only called after an operation has failed,
+// so they always wait (until the other side signals, or the timeout expires).
+// The other side is only signaled if it is actually waiting, and there is enough
+// free space or data to make it worthwhile. A Put() or Del() that happens right
+// before the 'waiting' flag is set doesn't signal, but the next one will (and
+// cCondWait remembers a signal that arrives before Wait() has been called):
+
 void cRingBuffer::WaitForPut(void)
 {
-  if (putTimeout)
+  if (putTimeout) {
+     __atomic_store_n(&putWaiting, true, __ATOMIC_SEQ_CST);
      readyForPut.Wait(putTimeout);
+     __atomic_store_n(&putWaiting, false, __ATOMIC_SEQ_CST);
+     }
 }
 
 void cRingBuffer::WaitForGet(void)
 {
-  if (getTimeout)
+  if (getTimeout) {
+     __atomic_store_n(&getWaiting, true, __ATOMIC_SEQ_CST);
      readyForGet.Wait(getTimeout);
+     __atomic_store_n(&getWaiting, false, __ATOMIC_SEQ_CST);
+     }
 }
 
 void cRingBuffer::EnablePut(void)
 {
-  if (putTimeout && Free() > Size() / 10)
+  if (putTimeout && __atomic_load_n(&putWaiting, __ATOMIC_SEQ_CST) && Free() > Size() / 10)
      readyForPut.Signal();
 }
 
 void cRingBuffer::EnableGet(void)
 {
-  if (getTimeout && Available() > Size() / 10)
+  if (getTimeout && __atomic_load_n(&getWaiting, __ATOMIC_SEQ_CST) && Available() > Size() / 10)
      readyForGet.Signal();
 }
 
@@ -210,14 +224,14 @@ int cRingBufferLinear::DataReady(const uchar *Data, int Count)
 
 int cRingBufferLinear::Available(void)
 {
-  int diff = head - tail;
+  int diff = LoadHead() - LoadTail();
   return (diff >= 0) ? diff : Size() + diff - margin;
 }
 
 void cRingBufferLinear::Clear(void)
 {
-  int Head = head;
-  tail = Head;
+  int Head = LoadHead();
+  StoreTail(Head);
 #ifdef DEBUGRINGBUFFERS
   lastHead = Head;
   lastTail = tail;
@@ -229,7 +243,7 @@ void cRingBufferLinear::Clear(void)
 
 int cRingBufferLinear::Read(int FileHandle, int Max)
 {
-  int Tail = tail;
+  int Tail = LoadTail();
   int diff = Tail - head;
   int free = (diff > 0) ? diff - 1 : Size() - head;
   if (Tail <= margin)
@@ -244,9 +258,9 @@ int cRingBufferLinear::Read(int FileHandle, int Max)
         int Head = head + Count;
         if (Head >= Size())
            Head = margin;
-        head = Head;
+        StoreHead(Head);
         if (statistics) {
-           int fill = head - Tail;
+           int fill = Head - Tail;
            if (fill < 0)
               fill = Size() + fill;
            else if (fill >= Size())
@@ -267,7 +281,7 @@ int cRingBufferLinear::Read(int FileHandle, int Max)
 
 int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
 {
-  int Tail = tail;
+  int Tail = LoadTail();
   int diff = Tail - head;
   int free = (diff > 0) ? diff - 1 : Size() - head;
   if (Tail <= margin)
@@ -282,9 +296,9 @@ int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
         int Head = head + Count;
         if (Head >= Size())
            Head = margin;
-        head = Head;
+        StoreHead(Head);
         if (statistics) {
-           int fill = head - Tail;
+           int fill = Head - Tail;
            if (fill < 0)
               fill = Size() + fill;
            else if (fill >= Size())
@@ -306,7 +320,7 @@ int cRingBufferLinear::Read(cUnbufferedFile *File, int Max)
 int cRingBufferLinear::Put(const uchar *Data, int Count)
 {
   if (Count > 0) {
-     int Tail = tail;
+     int Tail = LoadTail();
      int rest = Size() - head;
      int diff = Tail - head;
      int free = ((Tail < margin) ? rest : (diff > 0) ? diff : Size() + diff - margin) - 1;
@@ -323,11 +337,11 @@ int cRingBufferLinear::Put(const uchar *Data, int Count)
            memcpy(buffer + head, Data, rest);
            if (Count - rest)
               memcpy(buffer + margin, Data + rest, Count - rest);
-           head = margin + Count - rest;
+           StoreHead(margin + Count - rest);
            }
         else {
            memcpy(buffer + head, Data, Count);
-           head += Count;
+           StoreHead(head + Count);
            }
         }
      else
@@ -345,14 +359,14 @@ int cRingBufferLinear::Put(const uchar *Data, int Count)
 
 uchar *cRingBufferLinear::Get(int &Count)
 {
-  int Head = head;
+  int Head = LoadHead();
   if (getThreadTid <= 0)
      getThreadTid = cThread::ThreadId();
   int rest = Size() - tail;
   if (rest < margin && Head < tail) {
      int t = margin - rest;
      memcpy(buffer + t, buffer + tail, rest);
-     tail = t;
+     StoreTail(t);
      rest = Head - tail;
      }
   int diff = Head - tail;
@@ -380,7 +394,7 @@ void cRingBufferLinear::Del(int Count)
      gotten -= Count;
      if (Tail >= Size())
         Tail = margin;
-     tail = Tail;
+     StoreTail(Tail);
      EnablePut();
      }
 #ifdef DEBUGRINGBUFFERS
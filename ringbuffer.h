@@ -13,9 +13,12 @@
 #include "thread.h"
 #include "tools.h"
 
+#define CACHELINESIZE 64 // used to keep data written by different threads apart
+
 class cRingBuffer {
 private:
   cCondWait readyForPut, readyForGet;
+  int putWaiting, getWaiting; // accessed atomically
   int putTimeout;
   int getTimeout;
   int size;
@@ -58,10 +61,23 @@ public:
   static void PrintDebugRBL(void);
 #endif
 private:
-  int margin, head, tail;
-  int gotten;
+  // Since a cRingBufferLinear is used by exactly one producer and one consumer
+  // thread, 'head' (written only by the producer) and 'tail' (written only by
+  // the consumer) are accessed atomically and without any locking, and are kept
+  // in separate cache lines (padding):
+  int margin;
   uchar *buffer;
   char *description;
+  char padding1[CACHELINESIZE];
+  int head;
+  char padding2[CACHELINESIZE];
+  int tail;
+  int gotten;
+  char padding3[CACHELINESIZE];
+  int LoadHead(void) { return __atomic_load_n(&head, __ATOMIC_ACQUIRE); }
+  int LoadTail(void) { return __atomic_load_n(&tail, __ATOMIC_ACQUIRE); }
+  void StoreHead(int Head) { __atomic_store_n(&head, Head, __ATOMIC_SEQ_CST); }
+  void StoreTail(int Tail) { __atomic_store_n(&tail, Tail, __ATOMIC_SEQ_CST); }
 protected:
   virtual int DataReady(const uchar *Data, int Count);
     ///< By default a ring buffer has data ready as soon as there are at least
@@ -1918,11 +1918,11 @@ void cSVDRPServer::CmdLSTR(const char *Option)
         }
      }
   else if (Recordings->Count()) {
-     const cRecording *Recording = Recordings->First();
-     while (Recording) {
-           Reply(Recording == Recordings->Last() ? 250 : -250, "%d %s", Recording->Id(), Recording->Title(' ', true));
-           Recording = Recordings->Next(Recording);
-           }
+     const cVector<const cRecording *> &SortedRecordings = Recordings->Sorted();
+     for (int i = 0; i < SortedRecordings.Size(); i++) {
+         const cRecording *Recording = SortedRecordings[i];
+         Reply(i == SortedRecordings.Size() - 1 ? 250 : -250, "%d %s", Recording->Id(), Recording->Title(' ', true));
+         }
      }
   else
      Reply(550, "No recordings available");
@@ -0,0 +1,165 @@
+/*
+ * benchrecordings.c: Benchmark for looking up recordings in cRecordings
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Fills a cRecordings list with the given number of recordings (which only
+ * exist in memory, except for one that is actually renamed on disk) and
+ * reports the time per lookup of cRecordings::GetByName() and GetById(),
+ * compared to a linear scan of the list by file name (which is what
+ * GetByName() used to do). It also reports the time the first GetByName()
+ * takes after a recording has been renamed, which rebuilds the name index.
+ *
+ * Usage: tests/benchrecordings [ -n recordings ] [ -l lookups ]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "recording.h"
+#include "tools.h"
+#include "videodir.h"
+
+#define DEFAULTRECORDINGS 50000
+#define DEFAULTLOOKUPS    100000
+#define LINEARLOOKUPS     1000 // the linear scan is slow, so fewer lookups are done
+#define RENAMES           10
+
+static char VideoDir[] = "/tmp/vdr-benchrecordings.XXXXXX";
+
+// --- cBenchTimer -----------------------------------------------------------
+
+class cBenchTimer {
+private:
+  struct timespec start;
+  double seconds;
+public:
+  cBenchTimer(void) { seconds = 0; }
+  void Start(void) { clock_gettime(CLOCK_MONOTONIC, &start); }
+  void Stop(void);
+  double Seconds(void) const { return seconds; }
+  };
+
+void cBenchTimer::Stop(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  seconds = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// --- Benchmarks ------------------------------------------------------------
+
+static const cRecording *LinearScan(const cRecordings &Recordings, const char *FileName)
+{
+  for (const cRecording *Recording = Recordings.First(); Recording; Recording = Recordings.Next(Recording)) {
+      if (strcmp(Recording->FileName(), FileName) == 0)
+         return Recording;
+      }
+  return NULL;
+}
+
+static void Report(const char *Name, const cBenchTimer &Timer, int Lookups, int Errors)
+{
+  printf("  %-32s %10.2f us per lookup", Name, Timer.Seconds() * 1e6 / Lookups);
+  if (Errors)
+     printf(" (%d lookups FAILED)", Errors);
+  printf("\n");
+}
+
+static bool Benchmark(int Count, int Lookups)
+{
+  cRecordings Recordings;
+  cString *FileNames = new cString[Count];
+  for (int i = 0; i < Count; i++) {
+      FileNames[i] = cString::sprintf("%s/Bench/Recording %05d/2020-01-01.20.15.%d-0.rec", VideoDir, i, i % 10 + 1);
+      Recordings.Add(new cRecording(FileNames[i]));
+      }
+  printf("%d recordings\n", Recordings.Count());
+  int Errors = 0;
+  cBenchTimer Timer;
+  srand(1);
+  // GetByName():
+  Recordings.GetByName(FileNames[0]); // makes sure the name index is up to date
+  Timer.Start();
+  for (int i = 0; i < Lookups; i++) {
+      if (!Recordings.GetByName(FileNames[rand() % Count]))
+         Errors++;
+      }
+  Timer.Stop();
+  Report("cRecordings::GetByName()", Timer, Lookups, Errors);
+  // GetById() (the ids are assigned in the order the recordings were added):
+  int FirstId = Recordings.First()->Id();
+  Errors = 0;
+  Timer.Start();
+  for (int i = 0; i < Lookups; i++) {
+      if (!Recordings.GetById(FirstId + rand() % Count))
+         Errors++;
+      }
+  Timer.Stop();
+  Report("cRecordings::GetById()", Timer, Lookups, Errors);
+  // A linear scan by file name, for comparison:
+  int Linear = min(Lookups, LINEARLOOKUPS);
+  Errors = 0;
+  Timer.Start();
+  for (int i = 0; i < Linear; i++) {
+      if (!LinearScan(Recordings, FileNames[rand() % Count]))
+         Errors++;
+      }
+  Timer.Stop();
+  Report("linear scan", Timer, Linear, Errors);
+  // Rebuilding the name index after a rename:
+  bool Ok = true;
+  cRecording *Recording = Recordings.Last();
+  if (MakeDirs(Recording->FileName(), true)) {
+     double Total = 0;
+     for (int i = 0; i < RENAMES; i++) {
+         if (!Recording->ChangeName(cString::sprintf("Bench/Renamed %d", i))) {
+            Ok = false;
+            break;
+            }
+         Timer.Start();
+         const cRecording *r = Recordings.GetByName(Recording->FileName());
+         Timer.Stop();
+         if (r != Recording) {
+            fprintf(stderr, "renamed recording not found\n");
+            Ok = false;
+            break;
+            }
+         Total += Timer.Seconds();
+         }
+     if (Ok)
+        printf("  %-32s %10.2f ms\n", "rebuilding the name index", Total * 1e3 / RENAMES);
+     RemoveFileOrDir(Recording->FileName());
+     }
+  else
+     Ok = false;
+  delete[] FileNames;
+  return Ok;
+}
+
+int main(int argc, char *argv[])
+{
+  int Count = DEFAULTRECORDINGS;
+  int Lookups = DEFAULTLOOKUPS;
+  int c;
+  while ((c = getopt(argc, argv, "n:l:")) != -1) {
+        switch (c) {
+          case 'n': Count = max(atoi(optarg), 1);
+                    break;
+          case 'l': Lookups = max(atoi(optarg), 1);
+                    break;
+          default:  fprintf(stderr, "usage: %s [ -n recordings ] [ -l lookups ]\n", argv[0]);
+                    return 2;
+          }
+        }
+  if (!mkdtemp(VideoDir)) {
+     perror(VideoDir);
+     return 1;
+     }
+  cVideoDirectory::SetName(VideoDir);
+  bool Ok = Benchmark(Count, Lookups);
+  RemoveEmptyDirectories(VideoDir, true);
+  return Ok ? 0 : 1;
+}
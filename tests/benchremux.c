@@ -0,0 +1,209 @@
+/*
+ * benchremux.c: Benchmark for the TS parsers in remux.c
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Feeds the given TS files (typically the 00001.ts etc. files of recordings)
+ * through cPatPmtParser::ParsePatPmt(), cFrameDetector::Analyze() and cTsToPes,
+ * and reports the throughput of each of them in MB/s, frames/s and (on x86)
+ * CPU cycles per TS packet.
+ *
+ * Usage: tests/benchremux [ -r repeat ] file.ts ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define HAS_RDTSC 1
+#endif
+#include "remux.h"
+#include "tools.h"
+
+#define MAXBENCHSIZE  MEGABYTE(256) // the maximum amount of data used from each file
+#define DEFAULTREPEAT 3             // each benchmark is run this many times, and the best run counts
+
+// --- cBenchTimer -----------------------------------------------------------
+
+class cBenchTimer {
+private:
+  struct timespec start;
+  uint64_t startCycles;
+  double seconds;
+  uint64_t cycles;
+public:
+  cBenchTimer(void) { seconds = 0; cycles = 0; startCycles = 0; }
+  void Start(void);
+  void Stop(void);
+  double Seconds(void) const { return seconds; }
+  uint64_t Cycles(void) const { return cycles; }
+  };
+
+void cBenchTimer::Start(void)
+{
+  clock_gettime(CLOCK_MONOTONIC, &start);
+#ifdef HAS_RDTSC
+  startCycles = __rdtsc();
+#endif
+}
+
+void cBenchTimer::Stop(void)
+{
+#ifdef HAS_RDTSC
+  cycles = __rdtsc() - startCycles;
+#endif
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  seconds = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// --- Benchmarks ------------------------------------------------------------
+
+static int RunPatPmtParser(const uchar *Data, int Length)
+{
+  cPatPmtParser PatPmtParser;
+  int Found = 0;
+  for (; Length >= TS_SIZE; Data += TS_SIZE, Length -= TS_SIZE) {
+      if (PatPmtParser.ParsePatPmt(Data, TS_SIZE))
+         Found++;
+      }
+  return Found;
+}
+
+static int RunFrameDetector(const uchar *Data, int Length, int Pid, int Type)
+{
+  cFrameDetector FrameDetector(Pid, Type);
+  int Frames = 0;
+  while (Length > 0) {
+        int Count = FrameDetector.Analyze(Data, Length);
+        if (!Count)
+           break; // not enough data left
+        if (FrameDetector.NewFrame())
+           Frames++;
+        Data += Count;
+        Length -= Count;
+        }
+  return Frames;
+}
+
+static int RunTsToPes(const uchar *Data, int Length, int Pid)
+{
+  cTsToPes TsToPes;
+  int Packets = 0;
+  for (; Length >= TS_SIZE; Data += TS_SIZE, Length -= TS_SIZE) {
+      if (TsPid(Data) == Pid && TsHasPayload(Data)) {
+         if (TsPayloadStart(Data)) {
+            int l;
+            while (TsToPes.GetPes(l))
+                  Packets++;
+            TsToPes.Reset();
+            }
+         TsToPes.PutTs(Data, TS_SIZE);
+         }
+      }
+  return Packets;
+}
+
+static void Report(const char *Name, const cBenchTimer &Timer, int Length, int Frames)
+{
+  double MBs = Timer.Seconds() > 0 ? Length / Timer.Seconds() / MEGABYTE(1) : 0;
+  double Fps = Timer.Seconds() > 0 ? Frames / Timer.Seconds() : 0;
+  printf("  %-30s %10.1f MB/s %12.0f frames/s", Name, MBs, Fps);
+#ifdef HAS_RDTSC
+  printf(" %8.1f cycles/packet", double(Timer.Cycles()) / (Length / TS_SIZE));
+#endif
+  printf("\n");
+}
+
+// ---------------------------------------------------------------------------
+
+static bool Benchmark(const char *FileName, int Repeat)
+{
+  int fd = open(FileName, O_RDONLY);
+  if (fd < 0) {
+     perror(FileName);
+     return false;
+     }
+  uchar *Buffer = MALLOC(uchar, MAXBENCHSIZE);
+  int Length = Buffer ? safe_read(fd, Buffer, MAXBENCHSIZE) : -1;
+  close(fd);
+  if (Length < 0) {
+     perror(FileName);
+     free(Buffer);
+     return false;
+     }
+  // Skip any partial packet at the beginning and make sure we only have complete packets:
+  const uchar *Data = Buffer;
+  while (Length >= TS_SIZE && (Data[0] != TS_SYNC_BYTE || Length > TS_SIZE && Data[TS_SIZE] != TS_SYNC_BYTE)) {
+        Data++;
+        Length--;
+        }
+  Length -= Length % TS_SIZE;
+  // Determine the PID of the stream that defines the frames, just like cRecorder does:
+  cPatPmtParser PatPmtParser;
+  for (int i = 0; i < Length && !PatPmtParser.ParsePatPmt(Data + i, TS_SIZE); i += TS_SIZE)
+      ;
+  int Pid = PatPmtParser.Vpid();
+  int Type = PatPmtParser.Vtype();
+  if (!Pid && PatPmtParser.Apid(0)) {
+     Pid = PatPmtParser.Apid(0);
+     Type = 0x04;
+     }
+  if (!Pid && PatPmtParser.Dpid(0)) {
+     Pid = PatPmtParser.Dpid(0);
+     Type = 0x06;
+     }
+  if (!Pid) {
+     fprintf(stderr, "%s: no PAT/PMT found\n", FileName);
+     free(Buffer);
+     return false;
+     }
+  int Frames = RunFrameDetector(Data, Length, Pid, Type);
+  printf("%s: %.1f MB, %d packets, %d frames, pid %d, type 0x%02X\n", FileName, double(Length) / MEGABYTE(1), Length / TS_SIZE, Frames, Pid, Type);
+  cBenchTimer Best[3];
+  for (int r = 0; r < Repeat; r++) {
+      cBenchTimer Timer[3];
+      Timer[0].Start();
+      RunPatPmtParser(Data, Length);
+      Timer[0].Stop();
+      Timer[1].Start();
+      RunFrameDetector(Data, Length, Pid, Type);
+      Timer[1].Stop();
+      Timer[2].Start();
+      RunTsToPes(Data, Length, Pid);
+      Timer[2].Stop();
+      for (int i = 0; i < 3; i++) {
+          if (r == 0 || Timer[i].Seconds() < Best[i].Seconds())
+             Best[i] = Timer[i];
+          }
+      }
+  Report("cPatPmtParser::ParsePatPmt()", Best[0], Length, Frames);
+  Report("cFrameDetector::Analyze()", Best[1], Length, Frames);
+  Report("cTsToPes", Best[2], Length, Frames);
+  free(Buffer);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int Repeat = DEFAULTREPEAT;
+  int c;
+  while ((c = getopt(argc, argv, "r:")) != -1) {
+        switch (c) {
+          case 'r': Repeat = max(atoi(optarg), 1);
+                    break;
+          default:  return 2;
+          }
+        }
+  if (optind >= argc) {
+     fprintf(stderr, "usage: %s [ -r repeat ] file.ts ...\n", argv[0]);
+     return 2;
+     }
+  bool Ok = true;
+  for (int i = optind; i < argc; i++)
+      Ok &= Benchmark(argv[i], Repeat);
+  return Ok ? 0 : 1;
+}
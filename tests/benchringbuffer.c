@@ -0,0 +1,176 @@
+/*
+ * benchringbuffer.c: Benchmark for cRingBufferLinear
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Runs a producer and a consumer thread that pass TS packets through a
+ * cRingBufferLinear, set up the same way cRecorder uses it. The producer
+ * first puts data as fast as possible, and the throughput and the CPU time
+ * used by both threads are reported. Then it puts data at the given rates
+ * (in Mbit/s), and also the number of bytes that had to be dropped because
+ * the buffer was full is reported.
+ *
+ * To compare two versions of VDR, run "make bench" and this program in both
+ * source trees on the same machine.
+ *
+ * Usage: tests/benchringbuffer [ -s seconds ] [ Mbit/s ... ]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "remux.h"
+#include "ringbuffer.h"
+#include "thread.h"
+
+#define BENCHBUFSIZE     (MEGABYTE(20) / TS_SIZE * TS_SIZE) // as in cRecorder
+#define PUTPACKETS       32  // the number of TS packets in each Put()
+#define PUTINTERVAL      2   // ms between Put() calls when running at a given rate
+#define DEFAULTSECONDS   5
+
+static const int DefaultRates[] = { 80, 200, 1000 }; // Mbit/s
+
+// --- cProducer -------------------------------------------------------------
+
+class cProducer : public cThread {
+private:
+  cRingBufferLinear *ringBuffer;
+  uint64_t rate; // bytes per second, 0 = unlimited
+  uint64_t put;
+  uint64_t dropped;
+protected:
+  virtual void Action(void);
+public:
+  cProducer(cRingBufferLinear *RingBuffer, int Mbps);
+  void Stop(void) { Cancel(3); }
+  uint64_t Dropped(void) { return dropped; }
+  };
+
+cProducer::cProducer(cRingBufferLinear *RingBuffer, int Mbps)
+:cThread("benchmark producer")
+{
+  ringBuffer = RingBuffer;
+  rate = uint64_t(Mbps) * 1000000 / 8;
+  put = dropped = 0;
+}
+
+void cProducer::Action(void)
+{
+  uchar Data[PUTPACKETS * TS_SIZE];
+  for (int i = 0; i < PUTPACKETS; i++) {
+      uchar *p = Data + i * TS_SIZE;
+      memset(p, 0xFF, TS_SIZE);
+      p[0] = TS_SYNC_BYTE;
+      p[1] = 0x01;
+      p[2] = 0x00;
+      p[3] = 0x10;
+      }
+  cTimeMs Time;
+  while (Running()) {
+        if (rate) {
+           uint64_t Due = rate * Time.Elapsed() / 1000;
+           if (put + dropped >= Due) {
+              cCondWait::SleepMs(PUTINTERVAL);
+              continue;
+              }
+           }
+        int p = ringBuffer->Put(Data, sizeof(Data));
+        put += p;
+        if (p != int(sizeof(Data)))
+           dropped += sizeof(Data) - p;
+        }
+}
+
+// --- cConsumer -------------------------------------------------------------
+
+class cConsumer : public cThread {
+private:
+  cRingBufferLinear *ringBuffer;
+  uint64_t gotten;
+  int checksum;
+protected:
+  virtual void Action(void);
+public:
+  cConsumer(cRingBufferLinear *RingBuffer);
+  void Stop(void) { Cancel(3); }
+  uint64_t Gotten(void) { return gotten; }
+  };
+
+cConsumer::cConsumer(cRingBufferLinear *RingBuffer)
+:cThread("benchmark consumer")
+{
+  ringBuffer = RingBuffer;
+  gotten = 0;
+  checksum = 0;
+}
+
+void cConsumer::Action(void)
+{
+  while (Running()) {
+        int Count;
+        if (uchar *b = ringBuffer->Get(Count)) {
+           Count -= Count % TS_SIZE;
+           for (int i = 0; i < Count; i += TS_SIZE)
+               checksum += b[i + 3]; // touch the data, like a real consumer would
+           ringBuffer->Del(Count);
+           gotten += Count;
+           }
+        }
+}
+
+// ---------------------------------------------------------------------------
+
+static double CpuSeconds(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void Benchmark(int Mbps, int Seconds)
+{
+  cRingBufferLinear RingBuffer(BENCHBUFSIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE);
+  RingBuffer.SetTimeouts(0, 100);
+  cConsumer Consumer(&RingBuffer);
+  cProducer Producer(&RingBuffer, Mbps);
+  double Cpu = CpuSeconds();
+  cTimeMs Time;
+  Consumer.Start();
+  Producer.Start();
+  cCondWait::SleepMs(Seconds * 1000);
+  Producer.Stop();
+  Consumer.Stop();
+  double Elapsed = Time.Elapsed() / 1000.0;
+  Cpu = CpuSeconds() - Cpu;
+  cString Rate = Mbps ? cString::sprintf("%d Mbit/s", Mbps) : cString("unlimited");
+  printf("%-15s %10.1f MB/s %10.1f Mbit/s %8.1f%% CPU", *Rate, Consumer.Gotten() / Elapsed / MEGABYTE(1), Consumer.Gotten() * 8 / Elapsed / 1e6, Cpu * 100 / Elapsed);
+  if (Mbps) // without a rate the producer always outruns the consumer, so dropped data is meaningless
+     printf(" %12llu bytes dropped", (unsigned long long)Producer.Dropped());
+  printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+  int Seconds = DEFAULTSECONDS;
+  int c;
+  while ((c = getopt(argc, argv, "s:")) != -1) {
+        switch (c) {
+          case 's': Seconds = max(atoi(optarg), 1);
+                    break;
+          default:  fprintf(stderr, "usage: %s [ -s seconds ] [ Mbit/s ... ]\n", argv[0]);
+                    return 2;
+          }
+        }
+  Benchmark(0, Seconds);
+  if (optind < argc) {
+     for (int i = optind; i < argc; i++)
+         Benchmark(atoi(argv[i]), Seconds);
+     }
+  else {
+     for (int i = 0; i < int(sizeof(DefaultRates) / sizeof(DefaultRates[0])); i++)
+         Benchmark(DefaultRates[i], Seconds);
+     }
+  return 0;
+}
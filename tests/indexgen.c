@@ -0,0 +1,233 @@
+/*
+ * indexgen.c: Test for generating index files in parallel
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Creates an MPEG-2 recording that consists of several files, generates its
+ * index file sequentially, from chunks of the recording, and from chunks some
+ * of which fail (so that the rest of the index is generated sequentially),
+ * and verifies that all three index files are identical byte by byte, and
+ * contain the frames that were actually written.
+ *
+ * This file includes recording.c, so that it can use small chunks, generate
+ * chunks even on a single CPU, and make chunks fail.
+ */
+
+#define IFG_CHUNK_SIZE  KILOBYTE(256)
+#define IFG_MIN_CPUS    1
+static bool FailChunks = false;
+#define IFG_FAIL_CHUNK(FileNumber, Begin) (FailChunks && (FileNumber) == 2 && (Begin) > 0)
+
+#include "recording.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include "channels.h"
+#include "remux.h"
+#include "videodir.h"
+
+#define NUMFILES        3
+#define FRAMESPERFILE 300
+#define GOPSIZE        12
+#define VPID          512
+#define MAXFRAMESIZE  KILOBYTE(20)
+
+static char VideoDir[] = "/tmp/vdr-indexgen.XXXXXX";
+static uchar Expected[NUMFILES * FRAMESPERFILE * sizeof(tIndexTs)]; // the index entries of the frames written
+
+// --- cTsWriter -------------------------------------------------------------
+
+class cTsWriter {
+private:
+  uchar buffer[MAXFRAMESIZE + 100 * TS_SIZE];
+  int length;
+  int counter;
+public:
+  cTsWriter(void) { length = 0; counter = 0; }
+  void Clear(void) { length = 0; }
+  void Put(const uchar *TsPacket) { memcpy(buffer + length, TsPacket, TS_SIZE); length += TS_SIZE; }
+  void PutPes(int Pid, const uchar *Data, int Length);
+  const uchar *Data(void) const { return buffer; }
+  int Length(void) const { return length; }
+  };
+
+void cTsWriter::PutPes(int Pid, const uchar *Data, int Length)
+{
+  bool PayloadStart = true;
+  while (Length > 0) {
+        uchar *p = buffer + length;
+        p[0] = TS_SYNC_BYTE;
+        p[1] = (PayloadStart ? TS_PAYLOAD_START : 0x00) | ((Pid >> 8) & TS_PID_MASK_HI);
+        p[2] = Pid & 0xFF;
+        p[3] = TS_PAYLOAD_EXISTS | counter;
+        counter = (counter + 1) & TS_CONT_CNT_MASK;
+        int Header = 4;
+        int n = min(Length, TS_SIZE - Header);
+        if (n < TS_SIZE - Header) {
+           // Fill the rest of the packet with an adaptation field:
+           p[3] |= TS_ADAPT_FIELD_EXISTS;
+           int Stuffing = TS_SIZE - Header - n - 1;
+           p[Header++] = Stuffing;
+           if (Stuffing > 0) {
+              p[Header++] = 0x00;
+              memset(p + Header, 0xFF, Stuffing - 1);
+              Header += Stuffing - 1;
+              }
+           }
+        memcpy(p + Header, Data, n);
+        Data += n;
+        Length -= n;
+        length += TS_SIZE;
+        PayloadStart = false;
+        }
+}
+
+// ---------------------------------------------------------------------------
+
+static int MakeFrame(uchar *Frame, int64_t Pts, bool Independent)
+{
+  // A video PES packet with an MPEG-2 picture header and random data (that
+  // doesn't contain any start codes):
+  uchar *p = Frame;
+  *p++ = 0x00;
+  *p++ = 0x00;
+  *p++ = 0x01;
+  *p++ = 0xE0;
+  *p++ = 0x00; // PES packet length 0 = unbounded
+  *p++ = 0x00;
+  *p++ = 0x80;
+  *p++ = 0x80; // PTS only
+  *p++ = 0x05;
+  *p++ = 0x21 | ((Pts >> 29) & 0x0E);
+  *p++ = Pts >> 22;
+  *p++ = (Pts >> 14) | 0x01;
+  *p++ = Pts >> 7;
+  *p++ = (Pts << 1) | 0x01;
+  *p++ = 0x00; // picture start code
+  *p++ = 0x00;
+  *p++ = 0x01;
+  *p++ = 0x00;
+  *p++ = 0x00;
+  *p++ = (Independent ? 1 : 2) << 3; // picture coding type I or P
+  for (int Size = 200 + rand() % (MAXFRAMESIZE - 1000); Size-- > 0; )
+      *p++ = 1 + rand() % 255;
+  return p - Frame;
+}
+
+static bool CreateRecording(const char *FileName)
+{
+  if (!MakeDirs(FileName, true))
+     return false;
+  srand(1);
+  cChannel Channel;
+  if (!Channel.Parse("Test:11111:h:S19.2E:27500:512=2:0:0:0:1:1:1:0"))
+     return false;
+  cPatPmtGenerator PatPmtGenerator(&Channel);
+  cFileName File(FileName, true);
+  cTsWriter TsWriter;
+  uchar Frame[MAXFRAMESIZE];
+  int Index = 0;
+  for (int Number = 1; Number <= NUMFILES; Number++) {
+      cUnbufferedFile *f = Number == 1 ? File.Open() : File.NextFile();
+      if (!f)
+         return false;
+      off_t Offset = 0;
+      for (int i = 0; i < FRAMESPERFILE; i++) {
+          bool Independent = i % GOPSIZE == 0;
+          TsWriter.Clear();
+          if (Independent) {
+             // Like cRecorder, write the PAT/PMT before every I-frame:
+             TsWriter.Put(PatPmtGenerator.GetPat());
+             int PmtIndex = 0;
+             while (uchar *pmt = PatPmtGenerator.GetPmt(PmtIndex))
+                   TsWriter.Put(pmt);
+             }
+          TsWriter.PutPes(VPID, Frame, MakeFrame(Frame, 900000 + Index * 3600, Independent));
+          if (f->Write(TsWriter.Data(), TsWriter.Length()) != TsWriter.Length())
+             return false;
+          tIndexTs Entry(Offset, Independent, Number);
+          memcpy(Expected + Index++ * sizeof(Entry), &Entry, sizeof(Entry));
+          Offset += TsWriter.Length();
+          }
+      }
+  return File.Close();
+}
+
+static uchar *Generate(const char *Name, const char *FileName, bool Update, int &Length)
+{
+  cString IndexFileName = AddDirectory(FileName, "index");
+  unlink(IndexFileName);
+  Length = -1;
+  if (GenerateIndex(FileName, Update)) {
+     int f = open(IndexFileName, O_RDONLY);
+     if (f >= 0) {
+        int Size = FileSize(IndexFileName);
+        if (uchar *Index = MALLOC(uchar, max(Size, 1))) {
+           Length = safe_read(f, Index, Size);
+           close(f);
+           if (Length == Size) {
+              printf("%s: %d entries\n", Name, int(Length / sizeof(tIndexTs)));
+              return Index;
+              }
+           free(Index);
+           }
+        else
+           close(f);
+        }
+     }
+  fprintf(stderr, "%s: can't generate index file\n", Name);
+  return NULL;
+}
+
+static bool Check(const char *Name, const uchar *Index, int Length, const uchar *Reference, int ReferenceLength)
+{
+  if (!Index || !Reference)
+     return false;
+  if (Length != ReferenceLength) {
+     fprintf(stderr, "%s: %d bytes instead of %d\n", Name, Length, ReferenceLength);
+     return false;
+     }
+  for (int i = 0; i < Length; i++) {
+      if (Index[i] != Reference[i]) {
+         fprintf(stderr, "%s: differs at entry %d\n", Name, int(i / sizeof(tIndexTs)));
+         return false;
+         }
+      }
+  return true;
+}
+
+int main(void)
+{
+  if (!mkdtemp(VideoDir)) {
+     perror(VideoDir);
+     return 1;
+     }
+  cVideoDirectory::SetName(VideoDir);
+  cString FileName = AddDirectory(VideoDir, "Test/2020-01-01.20.15.1-0.rec");
+  int Errors = 0;
+  if (CreateRecording(FileName)) {
+     int SequentialLength, ChunksLength, FallbackLength;
+     // Update mode without an index file always generates sequentially:
+     uchar *Sequential = Generate("sequential", FileName, true, SequentialLength);
+     uchar *Chunks = Generate("chunks", FileName, false, ChunksLength);
+     FailChunks = true;
+     uchar *Fallback = Generate("failing chunks", FileName, false, FallbackLength);
+     if (!Check("sequential", Sequential, SequentialLength, Expected, sizeof(Expected)))
+        Errors++;
+     if (!Check("chunks", Chunks, ChunksLength, Sequential, SequentialLength))
+        Errors++;
+     if (!Check("failing chunks", Fallback, FallbackLength, Sequential, SequentialLength))
+        Errors++;
+     free(Sequential);
+     free(Chunks);
+     free(Fallback);
+     }
+  else {
+     fprintf(stderr, "can't create recording %s\n", *FileName);
+     Errors++;
+     }
+  RemoveFileOrDir(FileName);
+  RemoveEmptyDirectories(VideoDir, true);
+  printf("%s\n", Errors ? "FAILED" : "PASSED");
+  return Errors ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * segments.c: Loopback test for cRecordingSegments
+ *
+ * See the main source file 'vdr.c' for copyright information and
+ * how to reach the author.
+ *
+ * Creates a recording that consists of several files, streams various index
+ * and time ranges of it to a local TCP socket with cRecordingSegments::Send()
+ * and verifies the received data byte by byte.
+ */
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "recording.h"
+#include "remux.h"
+#include "thread.h"
+#include "tools.h"
+#include "videodir.h"
+
+#define NUMFILES        3
+#define FRAMESPERFILE 500
+#define GOPSIZE        12
+
+static char VideoDir[] = "/tmp/vdr-segments.XXXXXX";
+static off_t fileSizes[NUMFILES + 1];
+
+static uchar Data(uint16_t FileNumber, off_t FileOffset)
+{
+  return (FileOffset + FileNumber * 7) & 0xFF;
+}
+
+static bool CreateRecording(const char *FileName)
+{
+  if (!MakeDirs(FileName, true))
+     return false;
+  srand(1);
+  {
+    cIndexFile Index(FileName, true);
+    cFileName File(FileName, true);
+    for (int Number = 1; Number <= NUMFILES; Number++) {
+        cUnbufferedFile *f = Number == 1 ? File.Open() : File.NextFile();
+        if (!f)
+           return false;
+        uchar Buffer[TS_SIZE * 100];
+        off_t Offset = 0;
+        for (int i = 0; i < FRAMESPERFILE; i++) {
+            int Length = TS_SIZE * (1 + rand() % 100);
+            if (!Index.Write(i % GOPSIZE == 0, Number, Offset))
+               return false;
+            for (int j = 0; j < Length; j++)
+                Buffer[j] = Data(Number, Offset + j);
+            if (f->Write(Buffer, Length) != Length)
+               return false;
+            Offset += Length;
+            }
+        fileSizes[Number] = Offset;
+        }
+    if (!File.Close())
+       return false;
+  }
+  // Make the index look old enough, so that this isn't taken for a recording that
+  // is still in progress (which would leave out the last frame):
+  cString IndexName = AddDirectory(FileName, "index");
+  struct timeval Times[2] = { { time(NULL) - 86400, 0 }, { time(NULL) - 86400, 0 } };
+  return utimes(IndexName, Times) == 0;
+}
+
+// --- cSender ---------------------------------------------------------------
+
+class cSender : public cThread {
+private:
+  const cRecordingSegments *segments;
+  int fd;
+  bool ok;
+protected:
+  virtual void Action(void) { ok = segments->Send(fd); }
+public:
+  cSender(const cRecordingSegments *Segments, int Fd);
+  bool Ok(void);
+  };
+
+cSender::cSender(const cRecordingSegments *Segments, int Fd)
+:cThread("segment sender")
+{
+  segments = Segments;
+  fd = Fd;
+  ok = false;
+  Start();
+}
+
+bool cSender::Ok(void)
+{
+  while (Active())
+        cCondWait::SleepMs(10);
+  return ok;
+}
+
+// ---------------------------------------------------------------------------
+
+static bool Check(const char *Name, cRecordingSegments &Segments, cIndexFile &Index, int FromIndex, int ToIndex, int SendFd, int ReceiveFd)
+{
+  uint16_t Number;
+  off_t Offset;
+  Index.Get(FromIndex, &Number, &Offset);
+  off_t Expected = 0;
+  if (ToIndex < Index.Last()) {
+     uint16_t ToNumber;
+     off_t ToOffset;
+     Index.Get(ToIndex + 1, &ToNumber, &ToOffset);
+     for (int n = Number; n < ToNumber; n++)
+         Expected += fileSizes[n];
+     Expected += ToOffset - Offset;
+     }
+  else {
+     for (int n = Number; n <= NUMFILES; n++)
+         Expected += fileSizes[n];
+     Expected -= Offset;
+     }
+  if (Segments.Length() != Expected) {
+     fprintf(stderr, "%s: expected %lld bytes, got %lld\n", Name, (long long)Expected, (long long)Segments.Length());
+     return false;
+     }
+  cSender Sender(&Segments, SendFd);
+  off_t Received = 0;
+  uchar Buffer[KILOBYTE(64)];
+  while (Received < Expected) {
+        ssize_t r = read(ReceiveFd, Buffer, min(off_t(sizeof(Buffer)), Expected - Received));
+        if (r <= 0) {
+           fprintf(stderr, "%s: read failed after %lld bytes\n", Name, (long long)Received);
+           return false;
+           }
+        for (ssize_t i = 0; i < r; i++) {
+            if (Offset >= fileSizes[Number]) {
+               Number++;
+               Offset = 0;
+               }
+            if (Buffer[i] != Data(Number, Offset)) {
+               fprintf(stderr, "%s: wrong data in file %d at offset %lld\n", Name, Number, (long long)Offset);
+               return false;
+               }
+            Offset++;
+            }
+        Received += r;
+        }
+  if (!Sender.Ok()) {
+     fprintf(stderr, "%s: Send() failed\n", Name);
+     return false;
+     }
+  printf("%s: %d segment(s), %lld bytes ok\n", Name, Segments.Count(), (long long)Received);
+  return true;
+}
+
+int main(void)
+{
+  if (!mkdtemp(VideoDir)) {
+     perror(VideoDir);
+     return 1;
+     }
+  cVideoDirectory::SetName(VideoDir);
+  cString FileName = AddDirectory(VideoDir, "Test/2020-01-01.20.15.1-0.rec");
+  int Errors = 0;
+  if (CreateRecording(FileName)) {
+     // Set up a TCP connection via the loopback interface:
+     int Listen = socket(AF_INET, SOCK_STREAM, 0);
+     int Receive = socket(AF_INET, SOCK_STREAM, 0);
+     int Send = -1;
+     struct sockaddr_in Address = {};
+     Address.sin_family = AF_INET;
+     Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+     socklen_t Length = sizeof(Address);
+     if (bind(Listen, (struct sockaddr *)&Address, sizeof(Address)) == 0 &&
+         listen(Listen, 1) == 0 &&
+         getsockname(Listen, (struct sockaddr *)&Address, &Length) == 0 &&
+         connect(Receive, (struct sockaddr *)&Address, sizeof(Address)) == 0)
+        Send = accept(Listen, NULL, NULL);
+     if (Send >= 0) {
+        cRecording Recording(FileName);
+        cIndexFile Index(FileName, false);
+        cRecordingSegments Segments(&Recording);
+        int Last = Index.Last();
+        struct { int from, to; } Ranges[] = {
+          { 0, -1 },                                         // everything
+          { 10, 20 },                                        // within the first file
+          { FRAMESPERFILE - 100, FRAMESPERFILE + 100 },      // across a file boundary
+          { FRAMESPERFILE - 1, FRAMESPERFILE },              // the last and first frame of two files
+          { FRAMESPERFILE, FRAMESPERFILE },                  // a single frame at the start of a file
+          { FRAMESPERFILE / 2, 2 * FRAMESPERFILE + 10 },     // across two file boundaries
+          { Last - 5, -1 },                                  // up to the end
+          };
+        for (int i = 0; i < int(sizeof(Ranges) / sizeof(Ranges[0])); i++) {
+            int From = Ranges[i].from;
+            int To = Ranges[i].to < 0 ? Last : Ranges[i].to;
+            cString Name = cString::sprintf("frames %d..%d", From, To);
+            if (!Segments.SetIndexRange(Ranges[i].from, Ranges[i].to)) {
+               fprintf(stderr, "%s: SetIndexRange() failed\n", *Name);
+               Errors++;
+               }
+            else if (!Check(Name, Segments, Index, From, To, Send, Receive))
+               Errors++;
+            }
+        // A time range starts at the I-frame at or before the given time:
+        int From = Index.GetNextIFrame(SecondsToFrames(10, Recording.FramesPerSecond()) + 1, false);
+        int To = SecondsToFrames(30, Recording.FramesPerSecond()) - 1;
+        if (!Segments.SetTimeRange(10, 30)) {
+           fprintf(stderr, "seconds 10..30: SetTimeRange() failed\n");
+           Errors++;
+           }
+        else if (!Check("seconds 10..30", Segments, Index, From, To, Send, Receive))
+           Errors++;
+        close(Send);
+        }
+     else {
+        perror("loopback connection");
+        Errors++;
+        }
+     close(Listen);
+     close(Receive);
+     }
+  else {
+     fprintf(stderr, "can't create recording %s\n", *FileName);
+     Errors++;
+     }
+  RemoveFileOrDir(FileName);
+  RemoveEmptyDirectories(VideoDir, true);
+  printf("%s\n", Errors ? "FAILED" : "PASSED");
+  return Errors ? 1 : 0;
+}
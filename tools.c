@@ -1805,9 +1805,147 @@ bool cSafeFile::Close(void)
 
 #define WRITE_BUFFER KILOBYTE(800)
 
+// --- cUnbufferedFileWriter -------------------------------------------------
+
+#define ASYNCWRITEBUFFERS       4 // the number of buffers used for asynchronous writing
+#define ASYNCWRITEBUFFERSIZE    MEGABYTE(1) // the size of each of these buffers (a multiple of the file system block size), and the alignment of the writes
+#define ASYNCWRITEMAXDELAY      500 // ms after which a partially filled buffer is written anyway
+
+class cUnbufferedFileWriter : public cThread {
+private:
+  cUnbufferedFile *file;
+  uchar *buffer[ASYNCWRITEBUFFERS];
+  int fill[ASYNCWRITEBUFFERS];
+  int head; // the buffer currently being filled by Put()
+  uint64_t headTime; // the time when the first data was put into the head buffer
+  off_t offset; // the file offset of the end of the data in the head buffer
+  int tail; // the next buffer to be written by Action()
+  int numFull; // the number of buffers that are waiting to be written (or are being written)
+  int error; // the errno of the first failed write (protected by mutex)
+  cMutex mutex;
+  cCondVar bufferFull, bufferWritten;
+  bool Submit(void);
+protected:
+  virtual void Action(void);
+public:
+  cUnbufferedFileWriter(cUnbufferedFile *File, bool LowPriority);
+  virtual ~cUnbufferedFileWriter();
+  bool Put(const void *Data, size_t Size);
+       ///< Copies the given Data into the buffers and hands full buffers over
+       ///< to the writer thread. Returns false if a previous write has failed,
+       ///< in which case no more data is written.
+  bool Flush(void);
+       ///< Waits until all data has been written. Returns false if any write has failed.
+  int Error(void) { cMutexLock MutexLock(&mutex); return error; }
+  };
+
+cUnbufferedFileWriter::cUnbufferedFileWriter(cUnbufferedFile *File, bool LowPriority)
+:cThread("async file writer", LowPriority)
+{
+  file = File;
+  for (int i = 0; i < ASYNCWRITEBUFFERS; i++) {
+      buffer[i] = MALLOC(uchar, ASYNCWRITEBUFFERSIZE);
+      fill[i] = 0;
+      }
+  head = tail = numFull = 0;
+  headTime = 0;
+  offset = 0;
+  error = 0;
+  Start();
+}
+
+cUnbufferedFileWriter::~cUnbufferedFileWriter()
+{
+  Flush();
+  Cancel(3);
+  for (int i = 0; i < ASYNCWRITEBUFFERS; i++)
+      free(buffer[i]);
+}
+
+bool cUnbufferedFileWriter::Submit(void)
+{
+  cMutexLock MutexLock(&mutex);
+  numFull++;
+  head = (head + 1) % ASYNCWRITEBUFFERS;
+  bufferFull.Broadcast();
+  while (numFull >= ASYNCWRITEBUFFERS) // wait until the next buffer has been written
+        bufferWritten.Wait(mutex);
+  return !error;
+}
+
+bool cUnbufferedFileWriter::Put(const void *Data, size_t Size)
+{
+  const uchar *p = (const uchar *)Data;
+  while (Size > 0) {
+        if (fill[head] == 0) {
+           cMutexLock MutexLock(&mutex);
+           if (!buffer[head] && !error)
+              error = ENOMEM;
+           if (error)
+              return false;
+           if (!numFull) // nothing is pending, so this is where the file actually is
+              offset = max(lseek(file->fd, 0, SEEK_CUR), off_t(0));
+           headTime = cTimeMs::Now();
+           }
+        // Each buffer ends at a multiple of ASYNCWRITEBUFFERSIZE, so that after a partially
+        // filled buffer has been written (see below) the writes get aligned again:
+        size_t n = min(Size, size_t(ASYNCWRITEBUFFERSIZE - offset % ASYNCWRITEBUFFERSIZE));
+        memcpy(buffer[head] + fill[head], p, n);
+        fill[head] += n;
+        offset += n;
+        p += n;
+        Size -= n;
+        if (offset % ASYNCWRITEBUFFERSIZE == 0 && !Submit())
+           return false;
+        }
+  if (fill[head] > 0 && cTimeMs::Now() - headTime >= ASYNCWRITEMAXDELAY && !Submit()) // don't let slow streams lag behind
+     return false;
+  return !Error();
+}
+
+bool cUnbufferedFileWriter::Flush(void)
+{
+  if (fill[head] > 0)
+     Submit();
+  cMutexLock MutexLock(&mutex);
+  while (numFull > 0)
+        bufferWritten.Wait(mutex);
+  return !error;
+}
+
+void cUnbufferedFileWriter::Action(void)
+{
+  mutex.Lock();
+  while (Running()) {
+        if (numFull) {
+           int i = tail;
+           if (!error) { // after a failed write the rest is dropped, so that the file doesn't get a hole
+              mutex.Unlock();
+              ssize_t w = file->WriteData(buffer[i], fill[i]);
+              int Errno = errno;
+              mutex.Lock();
+              if (w != fill[i])
+                 error = w < 0 ? Errno : EIO;
+              }
+           fill[i] = 0;
+           tail = (tail + 1) % ASYNCWRITEBUFFERS;
+           numFull--;
+           bufferWritten.Broadcast();
+           }
+        else
+           bufferFull.TimedWait(mutex, 100);
+        }
+  mutex.Unlock();
+}
+
+// --- cUnbufferedFile -------------------------------------------------------
+
 cUnbufferedFile::cUnbufferedFile(void)
 {
   fd = -1;
+  writer = NULL;
+  dataWritten = 0;
+  writeCalls = writeSyscalls = 0;
 }
 
 cUnbufferedFile::~cUnbufferedFile()
@@ -1820,6 +1958,8 @@ int cUnbufferedFile::Open(const char *FileName, int Flags, mode_t Mode)
   Close();
   fd = open(FileName, Flags, Mode);
   curpos = 0;
+  dataWritten = 0;
+  writeCalls = writeSyscalls = 0;
 #if USE_FADVISE_READ || USE_FADVISE_WRITE
   begin = lastpos = ahead = 0;
   cachedstart = 0;
@@ -1836,6 +1976,12 @@ int cUnbufferedFile::Open(const char *FileName, int Flags, mode_t Mode)
 int cUnbufferedFile::Close(void)
 {
   if (fd >= 0) {
+     int Error = 0;
+     if (writer) {
+        if (!writer->Flush())
+           Error = writer->Error();
+        DELETENULL(writer);
+        }
 #if USE_FADVISE_READ || USE_FADVISE_WRITE
      if (totwritten)    // if we wrote anything make sure the data has hit the disk before
         fdatasync(fd);  // calling fadvise, as this is our last chance to un-cache it.
@@ -1843,7 +1989,12 @@ int cUnbufferedFile::Close(void)
 #endif
      int OldFd = fd;
      fd = -1;
-     return close(OldFd);
+     int r = close(OldFd);
+     if (Error) {
+        errno = Error;
+        return -1;
+        }
+     return r;
      }
   errno = EBADF;
   return -1;
@@ -1870,6 +2021,8 @@ int cUnbufferedFile::FadviseDrop(off_t Offset, off_t Len)
 
 off_t cUnbufferedFile::Seek(off_t Offset, int Whence)
 {
+  if (writer)
+     writer->Flush();
   if (Whence == SEEK_SET && Offset == curpos)
      return curpos;
   curpos = lseek(fd, Offset, Whence);
@@ -1878,6 +2031,8 @@ off_t cUnbufferedFile::Seek(off_t Offset, int Whence)
 
 ssize_t cUnbufferedFile::Read(void *Data, size_t Size)
 {
+  if (writer)
+     writer->Flush();
   if (fd >= 0) {
 #if USE_FADVISE_READ
      off_t jumped = curpos-lastpos; // nonzero means we're not at the last offset
@@ -1936,55 +2091,187 @@ ssize_t cUnbufferedFile::Read(void *Data, size_t Size)
 
 ssize_t cUnbufferedFile::Write(const void *Data, size_t Size)
 {
-  if (fd >=0) {
-     ssize_t bytesWritten = safe_write(fd, Data, Size);
-#if USE_FADVISE_WRITE
-     if (bytesWritten > 0) {
-        begin = min(begin, curpos);
-        curpos += bytesWritten;
-        written += bytesWritten;
-        lastpos = max(lastpos, curpos);
-        if (written > WRITE_BUFFER) {
-           if (lastpos > begin) {
-              // Now do three things:
-              // 1) Start writeback of begin..lastpos range
-              // 2) Drop the already written range (by the previous fadvise call)
-              // 3) Handle nonpagealigned data.
-              //    This is why we double the WRITE_BUFFER; the first time around the
-              //    last (partial) page might be skipped, writeback will start only after
-              //    second call; the third call will still include this page and finally
-              //    drop it from cache.
-              off_t headdrop = min(begin, off_t(WRITE_BUFFER * 2));
-              posix_fadvise(fd, begin - headdrop, lastpos - begin + headdrop, POSIX_FADV_DONTNEED);
+  writeCalls++;
+  if (writer) {
+     if (writer->Put(Data, Size))
+        return Size;
+     errno = writer->Error();
+     return -1;
+     }
+  return WriteData(Data, Size);
+}
+
+bool cUnbufferedFile::SetAsyncWrite(bool On, bool LowPriority)
+{
+  if (On) {
+     if (!writer && fd >= 0)
+        writer = new cUnbufferedFileWriter(this, LowPriority);
+     }
+  else if (writer) {
+     bool Ok = writer->Flush();
+     int Error = writer->Error();
+     DELETENULL(writer);
+     if (!Ok) {
+        errno = Error;
+        return false;
+        }
+     }
+  return true;
+}
+
+ssize_t cUnbufferedFile::WriteV(const struct iovec *Iov, int Count)
+{
+  writeCalls++;
+  ssize_t Size = 0;
+  for (int i = 0; i < Count; i++)
+      Size += Iov[i].iov_len;
+  if (writer) {
+     for (int i = 0; i < Count; i++) {
+         if (!writer->Put(Iov[i].iov_base, Iov[i].iov_len)) {
+            errno = writer->Error();
+            return -1;
+            }
+         }
+     return Size;
+     }
+  if (fd >= 0) {
+     writeSyscalls++;
+     ssize_t w;
+     while ((w = writev(fd, Iov, Count)) < 0 && errno == EINTR)
+           ;
+     if (w < 0)
+        return w;
+     Written(w);
+     // Write whatever writev() didn't write:
+     ssize_t Offset = 0; // the offset of Iov[i] within the total data
+     for (int i = 0; i < Count; i++) {
+         ssize_t Length = Iov[i].iov_len;
+         if (w < Offset + Length) {
+            ssize_t Skip = max(w - Offset, ssize_t(0));
+            if (WriteData((const uchar *)Iov[i].iov_base + Skip, Length - Skip) < 0)
+               return -1;
+            }
+         Offset += Length;
+         }
+     return Size;
+     }
+  return -1;
+}
+
+#define COPYCHUNKSIZE MEGABYTE(1) // the buffer size for copying data if copy_file_range() can't be used
+
+ssize_t cUnbufferedFile::CopyFrom(cUnbufferedFile *File, off_t Offset, size_t Size)
+{
+  if (fd < 0 || !File || File->fd < 0) {
+     errno = EBADF;
+     return -1;
+     }
+  if (writer) {
+     // any data that has been written asynchronously must come first:
+     if (!writer->Flush()) {
+        errno = writer->Error();
+        return -1;
+        }
+     }
+  writeCalls++;
+  ssize_t Copied = 0;
+  bool CopyRange = true;
+  uchar *Buffer = NULL;
+  while (Copied < ssize_t(Size)) {
+        size_t Length = Size - Copied;
+        ssize_t n;
+        if (CopyRange) {
+           off64_t From = Offset + Copied;
+           writeSyscalls++;
+           n = copy_file_range(File->fd, &From, fd, NULL, Length, 0);
+           if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP || errno == EINVAL)) {
+              CopyRange = false; // copy_file_range() can't do this, so let's copy the data ourselves
+              continue;
               }
-           begin = lastpos = curpos;
-           totwritten += written;
-           written = 0;
-           // The above fadvise() works when writing slowly (recording), but could
-           // leave cached data around when writing at a high rate, e.g. when cutting,
-           // because by the time we try to flush the cached pages (above) the data
-           // can still be dirty - we are faster than the disk I/O.
-           // So we do another round of flushing, just like above, but at larger
-           // intervals -- this should catch any pages that couldn't be released
-           // earlier.
-           if (totwritten > MEGABYTE(32)) {
-              // It seems in some setups, fadvise() does not trigger any I/O and
-              // a fdatasync() call would be required do all the work (reiserfs with some
-              // kind of write gathering enabled), but the syncs cause (io) load..
-              // Uncomment the next line if you think you need them.
-              //fdatasync(fd);
-              off_t headdrop = min(off_t(curpos - totwritten), off_t(totwritten * 2));
-              posix_fadvise(fd, curpos - totwritten - headdrop, totwritten + headdrop, POSIX_FADV_DONTNEED);
-              totwritten = 0;
+           if (n > 0)
+              Written(n);
+           }
+        else {
+           if (!Buffer && !(Buffer = MALLOC(uchar, COPYCHUNKSIZE))) {
+              Copied = -1;
+              break;
+              }
+           n = pread(File->fd, Buffer, min(Length, size_t(COPYCHUNKSIZE)), Offset + Copied);
+           if (n > 0 && WriteData(Buffer, n) < 0) {
+              Copied = -1;
+              break;
               }
            }
+        if (n > 0)
+           Copied += n;
+        else if (n == 0) // EOF
+           break;
+        else if (errno != EINTR) {
+           Copied = -1;
+           break;
+           }
         }
-#endif
+  free(Buffer);
+  return Copied;
+}
+
+ssize_t cUnbufferedFile::WriteData(const void *Data, size_t Size)
+{
+  if (fd >=0) {
+     writeSyscalls++;
+     ssize_t bytesWritten = safe_write(fd, Data, Size);
+     if (bytesWritten > 0)
+        Written(bytesWritten);
      return bytesWritten;
      }
   return -1;
 }
 
+void cUnbufferedFile::Written(ssize_t Bytes)
+{
+  __atomic_add_fetch(&dataWritten, Bytes, __ATOMIC_RELEASE);
+#if USE_FADVISE_WRITE
+  begin = min(begin, curpos);
+  curpos += Bytes;
+  written += Bytes;
+  lastpos = max(lastpos, curpos);
+  if (written > WRITE_BUFFER) {
+     if (lastpos > begin) {
+        // Now do three things:
+        // 1) Start writeback of begin..lastpos range
+        // 2) Drop the already written range (by the previous fadvise call)
+        // 3) Handle nonpagealigned data.
+        //    This is why we double the WRITE_BUFFER; the first time around the
+        //    last (partial) page might be skipped, writeback will start only after
+        //    second call; the third call will still include this page and finally
+        //    drop it from cache.
+        off_t headdrop = min(begin, off_t(WRITE_BUFFER * 2));
+        posix_fadvise(fd, begin - headdrop, lastpos - begin + headdrop, POSIX_FADV_DONTNEED);
+        }
+     begin = lastpos = curpos;
+     totwritten += written;
+     written = 0;
+     // The above fadvise() works when writing slowly (recording), but could
+     // leave cached data around when writing at a high rate, e.g. when cutting,
+     // because by the time we try to flush the cached pages (above) the data
+     // can still be dirty - we are faster than the disk I/O.
+     // So we do another round of flushing, just like above, but at larger
+     // intervals -- this should catch any pages that couldn't be released
+     // earlier.
+     if (totwritten > MEGABYTE(32)) {
+        // It seems in some setups, fadvise() does not trigger any I/O and
+        // a fdatasync() call would be required do all the work (reiserfs with some
+        // kind of write gathering enabled), but the syncs cause (io) load..
+        // Uncomment the next line if you think you need them.
+        //fdatasync(fd);
+        off_t headdrop = min(off_t(curpos - totwritten), off_t(totwritten * 2));
+        posix_fadvise(fd, curpos - totwritten - headdrop, totwritten + headdrop, POSIX_FADV_DONTNEED);
+        totwritten = 0;
+        }
+     }
+#endif
+}
+
 cUnbufferedFile *cUnbufferedFile::Create(const char *FileName, int Flags, mode_t Mode)
 {
   cUnbufferedFile *File = new cUnbufferedFile;
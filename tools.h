@@ -26,6 +26,7 @@
 #include <syslog.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include "thread.h"
 
 typedef unsigned char uchar;
@@ -490,7 +491,10 @@ public:
 /// cUnbufferedFile is used for large files that are mainly written or read
 /// in a streaming manner, and thus should not be cached.
 
+class cUnbufferedFileWriter;
+
 class cUnbufferedFile {
+  friend class cUnbufferedFileWriter;
 private:
   int fd;
   off_t curpos;
@@ -502,7 +506,13 @@ private:
   size_t readahead;
   size_t written;
   size_t totwritten;
+  off_t dataWritten;
+  cUnbufferedFileWriter *writer;
+  int writeCalls;
+  int writeSyscalls;
   int FadviseDrop(off_t Offset, off_t Len);
+  void Written(ssize_t Bytes);
+  ssize_t WriteData(const void *Data, size_t Size);
 public:
   cUnbufferedFile(void);
   ~cUnbufferedFile();
@@ -512,6 +522,38 @@ public:
   off_t Seek(off_t Offset, int Whence);
   ssize_t Read(void *Data, size_t Size);
   ssize_t Write(const void *Data, size_t Size);
+  ssize_t WriteV(const struct iovec *Iov, int Count);
+       ///< Writes the Count blocks of data described by Iov in one go, and
+       ///< returns the total number of bytes written, or -1 in case of an error.
+  ssize_t CopyFrom(cUnbufferedFile *File, off_t Offset, size_t Size);
+       ///< Appends Size bytes of the given File, starting at Offset, to this file.
+       ///< The data is copied with copy_file_range(), so it doesn't have to pass
+       ///< through user space, and file systems that support it (like btrfs or XFS)
+       ///< can simply share the data blocks. If that isn't possible, the data is
+       ///< read and written the conventional way. Returns the number of bytes copied
+       ///< (which is less than Size if the end of File has been reached), or -1 in
+       ///< case of an error.
+  int WriteCalls(void) const { return writeCalls; }
+       ///< Returns the number of calls to Write() and WriteV() since the file has been opened.
+  int WriteSyscalls(void) const { return writeSyscalls; }
+       ///< Returns the number of actual write system calls since the file has been opened.
+       ///< In case of asynchronous writing, this value is only up to date after
+       ///< calling SetAsyncWrite(false).
+  off_t DataWritten(void) const { return __atomic_load_n(&dataWritten, __ATOMIC_ACQUIRE); }
+       ///< Returns the number of bytes that have actually been written to the file
+       ///< since it has been opened. In case of asynchronous writing, this is less
+       ///< than what has been given to Write() as long as the data is still waiting
+       ///< in the buffers. May be called from any thread.
+  bool SetAsyncWrite(bool On, bool LowPriority = false);
+       ///< If On is true, Write() only copies the data into large buffers, which are
+       ///< written to the file by a separate thread (which runs with low priority if
+       ///< LowPriority is true, see cThread). This way the caller won't be
+       ///< blocked by a slow disk (as long as there are free buffers). A buffer that
+       ///< is only partially filled is written after a short time, so that the data
+       ///< doesn't lag too far behind. An error in such a write will be reported by
+       ///< the next call to Write(), SetAsyncWrite(false) or Close().
+       ///< Returns false if On is false and any asynchronous write has failed
+       ///< (with errno set accordingly).
   static cUnbufferedFile *Create(const char *FileName, int Flags, mode_t Mode = DEFFILEMODE);
   };
 
@@ -789,7 +831,7 @@ public:
     if (Index < 0)
        return; // prevents out-of-bounds access
     if (Index < size - 1)
-       memmove(&data[Index], &data[Index + 1], (size - Index) * sizeof(T));
+       memmove(&data[Index], &data[Index + 1], (size - Index - 1) * sizeof(T));
     size--;
   }
   bool RemoveElement(const T &Data)
@@ -17,6 +17,7 @@ cTransfer::cTransfer(const cChannel *Channel)
   lastErrorReport = 0;
   numLostPackets = 0;
   patPmtGenerator.SetChannel(Channel);
+  SetBatchReceive();
 }
 
 cTransfer::~cTransfer()
@@ -41,25 +42,53 @@ void cTransfer::Activate(bool On)
 #define RETRYWAIT      5 // time (in ms) between two retries
 #define ERRORDELTA    60 // seconds before reporting lost TS packets again
 
+void cTransfer::Play(const uchar *Data, int Length)
+{
+  // Transfer Mode means "live tv", so there's no point in doing any additional
+  // buffering here. The TS packets *must* get through here! However, every
+  // now and then there may be conditions where the packets just can't be
+  // handled when offered the first time, so that's why we try several times:
+  while (Length > 0) {
+        int i = 0;
+        for ( ; i < MAXRETRIES; i++) {
+            int w = PlayTs(Data, Length);
+            if (w > 0) {
+               Data += w;
+               Length -= w;
+               break;
+               }
+            cCondWait::SleepMs(RETRYWAIT);
+            }
+        if (i >= MAXRETRIES) {
+           DeviceClear();
+           numLostPackets += (Length + TS_SIZE - 1) / TS_SIZE;
+           if (time(NULL) - lastErrorReport > ERRORDELTA) {
+              esyslog("ERROR: %d TS packet(s) not accepted in Transfer Mode", numLostPackets);
+              numLostPackets = 0;
+              lastErrorReport = time(NULL);
+              }
+           break;
+           }
+        }
+}
+
 void cTransfer::Receive(const uchar *Data, int Length)
+{
+  if (cPlayer::IsAttached())
+     Play(Data, Length);
+}
+
+void cTransfer::ReceiveBatch(const uchar *Data[], int Count)
 {
   if (cPlayer::IsAttached()) {
-     // Transfer Mode means "live tv", so there's no point in doing any additional
-     // buffering here. The TS packets *must* get through here! However, every
-     // now and then there may be conditions where the packet just can't be
-     // handled when offered the first time, so that's why we try several times:
-     for (int i = 0; i < MAXRETRIES; i++) {
-         if (PlayTs(Data, Length) > 0)
-            return;
-         cCondWait::SleepMs(RETRYWAIT);
+     for (int i = 0; i < Count; ) {
+         // Play runs of packets that directly follow each other in one go:
+         int n = 1;
+         while (i + n < Count && Data[i + n] == Data[i] + n * TS_SIZE)
+               n++;
+         Play(Data[i], n * TS_SIZE);
+         i += n;
          }
-     DeviceClear();
-     numLostPackets++;
-     if (time(NULL) - lastErrorReport > ERRORDELTA) {
-        esyslog("ERROR: %d TS packet(s) not accepted in Transfer Mode", numLostPackets);
-        numLostPackets = 0;
-        lastErrorReport = time(NULL);
-        }
      }
 }
 
@@ -19,9 +19,11 @@ private:
   time_t lastErrorReport;
   int numLostPackets;
   cPatPmtGenerator patPmtGenerator;
+  void Play(const uchar *Data, int Length);
 protected:
   virtual void Activate(bool On);
   virtual void Receive(const uchar *Data, int Length);
+  virtual void ReceiveBatch(const uchar *Data[], int Count);
 public:
   cTransfer(const cChannel *Channel);
   virtual ~cTransfer();